@@ -9,10 +9,25 @@
 
 #include "fbg_fbdev.h"
 
+// SIMD 16 bpp packers are only built with GCC compatible compilers (target attributes), they can be disabled with WITHOUT_SIMD
+#if !defined(WITHOUT_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define FBG_FBDEV_SIMD_X86
+    #include <immintrin.h>
+#endif
+
+#if !defined(WITHOUT_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    #define FBG_FBDEV_SIMD_ARM
+    #include <arm_neon.h>
+#endif
+
 void fbg_fbdevDraw(struct _fbg *fbg);
 void fbg_fbdevFlip(struct _fbg *fbg);
 void fbg_fbdevFree(struct _fbg *fbg);
 
+#ifdef FBG_PARALLEL
+int fbg_fbdevStartPresent(struct _fbg *fbg);
+#endif
+
 struct _fbg *fbg_fbdevSetup(char *fb_device, int page_flipping) {
     struct _fbg_fbdev_context *fbdev_context = (struct _fbg_fbdev_context *)calloc(1, sizeof(struct _fbg_fbdev_context));
     if (!fbdev_context) {
@@ -87,6 +102,14 @@ struct _fbg *fbg_fbdevSetup(char *fb_device, int page_flipping) {
         components = fbdev_context->vinfo.bits_per_pixel / 8;
     }
 
+#ifndef FBG_PARALLEL
+    if (page_flipping == FBG_FBDEV_TRIPLE_BUFFERING) {
+        fprintf(stdout, "fbg_fbdevSetup: triple buffering require FBG_PARALLEL (present thread), double buffering will be used.\n");
+
+        page_flipping = FBG_FBDEV_DOUBLE_BUFFERING;
+    }
+#endif
+
     struct _fbg *fbg = fbg_customSetup(fbdev_context->vinfo.xres, fbdev_context->vinfo.yres, components, 0, 0, (void *)fbdev_context, fbg_fbdevDraw, fbg_fbdevFlip, NULL, fbg_fbdevFree);
     if (!fbg) {
         fprintf(stderr, "fbg_fbdevSetup: fbg_customSetup failed\n");
@@ -98,34 +121,45 @@ struct _fbg *fbg_fbdevSetup(char *fb_device, int page_flipping) {
         return NULL;
     }
 
-    if ((fbdev_context->vinfo.bits_per_pixel == 24 || fbdev_context->vinfo.bits_per_pixel == 32) &&
-        fbdev_context->vinfo.red.length == 8 &&
-        fbdev_context->vinfo.red.offset == 16 &&
+    // render directly in the framebuffer component order so that it can be presented as is
+    if (fbdev_context->vinfo.bits_per_pixel == 16) {
+        // 24 bits rendering, the first component is packed in the lowest bits
+        if (fbdev_context->vinfo.red.offset == 11) {
+            fbg_setFormat(fbg, FBG_FORMAT_BGR888);
+        }
+    } else if (fbdev_context->vinfo.red.length == 8 &&
         fbdev_context->vinfo.green.length == 8 &&
         fbdev_context->vinfo.blue.length == 8 &&
-        fbdev_context->vinfo.blue.offset == 0 &&
         fbdev_context->vinfo.green.offset == 8) {
-        fbg->bgr = 1;
-    }
-
-    if (fbdev_context->vinfo.bits_per_pixel == 16 &&
-        fbdev_context->vinfo.red.offset == 11) {
-        fbg->bgr = 1;
+        if (fbdev_context->vinfo.red.offset == 16 && fbdev_context->vinfo.blue.offset == 0) {
+            fbg_setFormat(fbg, (components == 4) ? FBG_FORMAT_BGRX8888 : FBG_FORMAT_BGR888);
+        } else if (fbdev_context->vinfo.red.offset != 0 || fbdev_context->vinfo.blue.offset != 16) {
+            fprintf(stderr, "fbg_fbdevSetup: '%s' Unsupported components layout, colors may be wrong!\n", fb_device);
+        }
+    } else {
+        fprintf(stderr, "fbg_fbdevSetup: '%s' Unsupported components layout, colors may be wrong!\n", fb_device);
     }
 
     if (page_flipping) {
+        int pages = (page_flipping == FBG_FBDEV_TRIPLE_BUFFERING) ? 3 : 2;
+
         // check for page flipping support
         if (ioctl(fbdev_context->fd, FBIOPAN_DISPLAY, &fbdev_context->vinfo) == -1) {
             fprintf(stderr, "fbg_fbdevSetup: '%s' FBIOPAN_DISPLAY / page flipping not supported!\n", fb_device);
         } else {
-            // double the virtual height
-            fbdev_context->vinfo.yres_virtual = fbdev_context->vinfo.yres_virtual * 2;
+            // double / triple the virtual height
+            fbdev_context->vinfo.yres_virtual = fbdev_context->vinfo.yres_virtual * pages;
             if (ioctl(fbdev_context->fd, FBIOPUT_VSCREENINFO, &fbdev_context->vinfo) == -1) {
                 fprintf(stderr, "fbg_fbdevSetup: '%s' FBIOPUT_VSCREENINFO failed, page flipping disabled!\n", fb_device);
             } else {
                 fbdev_context->page_flipping = 1;
+                fbdev_context->triple_buffering = (pages == 3);
 
-                fprintf(stdout, "fbg_fbdevSetup: '%s' Page flipping enabled (virtual height was doubled)!\n", fb_device);
+                if (fbdev_context->triple_buffering) {
+                    fprintf(stdout, "fbg_fbdevSetup: '%s' Triple buffering enabled (virtual height was tripled)!\n", fb_device);
+                } else {
+                    fprintf(stdout, "fbg_fbdevSetup: '%s' Page flipping enabled (virtual height was doubled)!\n", fb_device);
+                }
 
                 if (ioctl(fbdev_context->fd, FBIOGET_FSCREENINFO, &fbdev_context->finfo) == -1) {
                     fprintf(stderr, "fbg_fbdevSetup: '%s' Cannot obtain framebuffer FBIOGET_FSCREENINFO informations!\n", fb_device);
@@ -154,69 +188,435 @@ struct _fbg *fbg_fbdevSetup(char *fb_device, int page_flipping) {
 
     // setup page flipping
     if (fbdev_context->page_flipping) {
+        // render straight into the pages : rows have the framebuffer line length
+        fbg->line_length = fbdev_context->finfo.line_length;
+        fbg->size = fbg->line_length * fbg->height;
+
         fbg->disp_buffer = fbdev_context->buffer;
-        fbg->back_buffer = fbdev_context->buffer + fbg->width * fbg->components * fbg->height;
-    } else {
-        // setup front & back buffers
-        fbg->back_buffer = calloc(1, fbg->size * sizeof(char));
-        if (!fbg->back_buffer) {
-            fprintf(stderr, "fbg_fbdevSetup: back_buffer calloc failed!\n");
+        fbg->back_buffer = fbdev_context->buffer + fbg->size;
+
+#ifdef FBG_PARALLEL
+        if (fbdev_context->triple_buffering && !fbg_fbdevStartPresent(fbg)) {
+            fprintf(stderr, "fbg_fbdevSetup: '%s' present thread failed, double buffering will be used!\n", fb_device);
 
-            close(fbdev_context->fd);
+            fbdev_context->triple_buffering = 0;
+        }
+#endif
+    } else {
+        // setup front & back buffers, owned by the context so that they come from its allocator (see fbg_setAllocator)
+        if (!fbg_allocDisplayBuffers(fbg)) {
+            fprintf(stderr, "fbg_fbdevSetup: buffers allocation failed!\n");
 
-            free(fbdev_context);
+            fbg_close(fbg);
 
             return NULL;
         }
+    }
 
-        fbg->disp_buffer = calloc(1, fbg->size * sizeof(char));
-        if (!fbg->disp_buffer) {
-            fprintf(stderr, "fbg_fbdevSetup: disp_buffer calloc failed!\n");
+    return fbg;
+}
 
-            free(fbg->back_buffer);
-            close(fbdev_context->fd);
+// 4x4 ordered dithering thresholds [0,15]
+static const unsigned char fbg_fbdevBayer[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+// dithering amounts of a display row for the 5 bits and 6 bits components (truncated bits), pattern repeated to 16 pixels starting at pixel x
+void fbg_fbdevDitherRow(int x, int y, unsigned char dither5[16], unsigned char dither6[16]) {
+    int i;
+    for (i = 0; i < 16; i += 1) {
+        int threshold = fbg_fbdevBayer[y & 3][(x + i) & 3];
+
+        dither5[i] = threshold >> 1;
+        dither6[i] = threshold >> 2;
+    }
+}
 
-            free(fbdev_context);
+// pack a row of 24 bits pixels to 16 bpp (5-6-5, the first component in the lowest bits, the render format follow the framebuffer components order)
+void fbg_fbdevPackRow(uint16_t *dst, const unsigned char *src, int count, const unsigned char *dither5, const unsigned char *dither6) {
+    int i;
 
-            return NULL;
+    if (dither5) {
+        for (i = 0; i < count; i += 1) {
+            int c0 = _FBG_MIN(src[0] + dither5[i & 3], 255);
+            int c1 = _FBG_MIN(src[1] + dither6[i & 3], 255);
+            int c2 = _FBG_MIN(src[2] + dither5[i & 3], 255);
+
+            dst[i] = (c0 >> 3) | ((c1 >> 2) << 5) | ((c2 >> 3) << 11);
+
+            src += 3;
+        }
+    } else {
+        for (i = 0; i < count; i += 1) {
+            dst[i] = (src[0] >> 3) | ((src[1] >> 2) << 5) | ((src[2] >> 3) << 11);
+
+            src += 3;
         }
     }
+}
 
-    return fbg;
+#ifdef FBG_FBDEV_SIMD_X86
+// pack 8 pixels (24 bytes, 4 bytes past them are read), dither holds the per byte amounts of 4 pixels spread over 32 bits lanes
+__attribute__((target("sse2")))
+static inline __m128i fbg_fbdevPack8SSE2(const unsigned char *src, __m128i dither) {
+    __m128i p0 = _mm_loadu_si128((__m128i *)src);
+    __m128i p1 = _mm_loadu_si128((__m128i *)(src + 12));
+
+    // one pixel per 32 bits lane (c0 | c1 << 8 | c2 << 16)
+    __m128i q0 = _mm_unpacklo_epi64(_mm_unpacklo_epi32(p0, _mm_srli_si128(p0, 3)), _mm_unpacklo_epi32(_mm_srli_si128(p0, 6), _mm_srli_si128(p0, 9)));
+    __m128i q1 = _mm_unpacklo_epi64(_mm_unpacklo_epi32(p1, _mm_srli_si128(p1, 3)), _mm_unpacklo_epi32(_mm_srli_si128(p1, 6), _mm_srli_si128(p1, 9)));
+
+    q0 = _mm_adds_epu8(q0, dither);
+    q1 = _mm_adds_epu8(q1, dither);
+
+    __m128i mask0 = _mm_set1_epi32(0x001f);
+    __m128i mask1 = _mm_set1_epi32(0x07e0);
+    __m128i mask2 = _mm_set1_epi32(0xf800);
+
+    q0 = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(q0, 3), mask0), _mm_and_si128(_mm_srli_epi32(q0, 5), mask1)), _mm_and_si128(_mm_srli_epi32(q0, 8), mask2));
+    q1 = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(q1, 3), mask0), _mm_and_si128(_mm_srli_epi32(q1, 5), mask1)), _mm_and_si128(_mm_srli_epi32(q1, 8), mask2));
+
+    // sign extend so that the signed saturation of the pack keep the 16 bits values
+    q0 = _mm_srai_epi32(_mm_slli_epi32(q0, 16), 16);
+    q1 = _mm_srai_epi32(_mm_slli_epi32(q1, 16), 16);
+
+    return _mm_packs_epi32(q0, q1);
+}
+
+// SSE2 version of fbg_fbdevPackRow, 32 pixels (a 64 bytes cache line) per iteration
+__attribute__((target("sse2")))
+void fbg_fbdevPackRowSSE2(uint16_t *dst, const unsigned char *src, int count, const unsigned char *dither5, const unsigned char *dither6) {
+    __m128i dither = _mm_setzero_si128();
+
+    if (dither5) {
+        dither = _mm_setr_epi8(dither5[0], dither6[0], dither5[0], 0, dither5[1], dither6[1], dither5[1], 0,
+            dither5[2], dither6[2], dither5[2], 0, dither5[3], dither6[3], dither5[3], 0);
+    }
+
+    int i = 0;
+    for (; i + 34 <= count; i += 32) {
+        __m128i v0 = fbg_fbdevPack8SSE2(src + i * 3, dither);
+        __m128i v1 = fbg_fbdevPack8SSE2(src + i * 3 + 24, dither);
+        __m128i v2 = fbg_fbdevPack8SSE2(src + i * 3 + 48, dither);
+        __m128i v3 = fbg_fbdevPack8SSE2(src + i * 3 + 72, dither);
+
+        _mm_storeu_si128((__m128i *)(dst + i), v0);
+        _mm_storeu_si128((__m128i *)(dst + i + 8), v1);
+        _mm_storeu_si128((__m128i *)(dst + i + 16), v2);
+        _mm_storeu_si128((__m128i *)(dst + i + 24), v3);
+    }
+
+    for (; i + 10 <= count; i += 8) {
+        _mm_storeu_si128((__m128i *)(dst + i), fbg_fbdevPack8SSE2(src + i * 3, dither));
+    }
+
+    // i is a multiple of 4 so the dithering pattern is still aligned
+    fbg_fbdevPackRow(dst + i, src + i * 3, count - i, dither5, dither6);
+}
+#endif
+
+#ifdef FBG_FBDEV_SIMD_ARM
+// pack 16 pixels
+static inline uint16x8x2_t fbg_fbdevPack16NEON(const unsigned char *src, uint8x16_t dither5, uint8x16_t dither6) {
+    uint8x16x3_t p = vld3q_u8(src);
+
+    uint8x16_t c0 = vqaddq_u8(p.val[0], dither5);
+    uint8x16_t c1 = vqaddq_u8(p.val[1], dither6);
+    uint8x16_t c2 = vqaddq_u8(p.val[2], dither5);
+
+    uint16x8x2_t v;
+
+    v.val[0] = vshll_n_u8(vget_low_u8(c2), 8);
+    v.val[0] = vsriq_n_u16(v.val[0], vshll_n_u8(vget_low_u8(c1), 8), 5);
+    v.val[0] = vsriq_n_u16(v.val[0], vshll_n_u8(vget_low_u8(c0), 8), 11);
+
+    v.val[1] = vshll_n_u8(vget_high_u8(c2), 8);
+    v.val[1] = vsriq_n_u16(v.val[1], vshll_n_u8(vget_high_u8(c1), 8), 5);
+    v.val[1] = vsriq_n_u16(v.val[1], vshll_n_u8(vget_high_u8(c0), 8), 11);
+
+    return v;
+}
+
+// NEON version of fbg_fbdevPackRow, 32 pixels (a 64 bytes cache line) per iteration
+void fbg_fbdevPackRowNEON(uint16_t *dst, const unsigned char *src, int count, const unsigned char *dither5, const unsigned char *dither6) {
+    uint8x16_t d5 = vdupq_n_u8(0);
+    uint8x16_t d6 = vdupq_n_u8(0);
+
+    if (dither5) {
+        d5 = vld1q_u8(dither5);
+        d6 = vld1q_u8(dither6);
+    }
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        uint16x8x2_t v0 = fbg_fbdevPack16NEON(src + i * 3, d5, d6);
+        uint16x8x2_t v1 = fbg_fbdevPack16NEON(src + i * 3 + 48, d5, d6);
+
+        vst1q_u16(dst + i, v0.val[0]);
+        vst1q_u16(dst + i + 8, v0.val[1]);
+        vst1q_u16(dst + i + 16, v1.val[0]);
+        vst1q_u16(dst + i + 24, v1.val[1]);
+    }
+
+    for (; i + 16 <= count; i += 16) {
+        uint16x8x2_t v = fbg_fbdevPack16NEON(src + i * 3, d5, d6);
+
+        vst1q_u16(dst + i, v.val[0]);
+        vst1q_u16(dst + i + 8, v.val[1]);
+    }
+
+    fbg_fbdevPackRow(dst + i, src + i * 3, count - i, dither5, dither6);
+}
+#endif
+
+// copy an area of the display buffer to the framebuffer (converted to 16 bpp if needed)
+void fbg_fbdevCopyArea(struct _fbg *fbg, struct _fbg_bbox *area) {
+    struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
+
+    int y = 0;
+
+    if (fbdev_context->vinfo.bits_per_pixel == 16) {
+        void (*pack_row)(uint16_t *dst, const unsigned char *src, int count, const unsigned char *dither5, const unsigned char *dither6) = fbg_fbdevPackRow;
+
+#ifdef FBG_FBDEV_SIMD_X86
+        if (fbg->simd & FBG_SIMD_SSE2) {
+            pack_row = fbg_fbdevPackRowSSE2;
+        }
+#endif
+
+#ifdef FBG_FBDEV_SIMD_ARM
+        if (fbg->simd & FBG_SIMD_NEON) {
+            pack_row = fbg_fbdevPackRowNEON;
+        }
+#endif
+
+        unsigned char dither5[16], dither6[16];
+
+        for (y = area->y1; y < area->y2; y += 1) {
+            unsigned char *pix_pointer_src = fbg->disp_buffer + y * fbg->line_length + area->x1 * 3;
+            uint16_t *pix_pointer_dst = (uint16_t *)(fbdev_context->buffer + y * fbdev_context->finfo.line_length + area->x1 * 2);
+
+            if (fbdev_context->dithering) {
+                fbg_fbdevDitherRow(area->x1, y, dither5, dither6);
+
+                pack_row(pix_pointer_dst, pix_pointer_src, area->x2 - area->x1, dither5, dither6);
+            } else {
+                pack_row(pix_pointer_dst, pix_pointer_src, area->x2 - area->x1, NULL, NULL);
+            }
+        }
+    } else {
+        int offset = area->x1 * fbg->components;
+        int length = (area->x2 - area->x1) * fbg->components;
+
+        for (y = area->y1; y < area->y2; y += 1) {
+            memcpy(fbdev_context->buffer + y * fbdev_context->finfo.line_length + offset, fbg->disp_buffer + y * fbg->line_length + offset, length);
+        }
+    }
+}
+
+void fbg_fbdevSetDithering(struct _fbg *fbg, int enable) {
+    struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
+
+    fbdev_context->dithering = enable;
 }
 
 void fbg_fbdevDraw(struct _fbg *fbg) {
     struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
 
 #ifdef FBIO_WAITFORVSYNC
-    static int dummy = 0;
-    ioctl(fbdev_context->fd, FBIO_WAITFORVSYNC, &dummy);
+    // the present thread wait for it with triple buffering
+    if (!fbdev_context->triple_buffering) {
+        static int dummy = 0;
+        ioctl(fbdev_context->fd, FBIO_WAITFORVSYNC, &dummy);
+    }
 #endif
 
     if (fbdev_context->page_flipping == 0) {
-        if (fbdev_context->vinfo.bits_per_pixel == 16) {
-            unsigned char *pix_pointer_src = fbg->disp_buffer;
-            unsigned char *pix_pointer_dst = fbdev_context->buffer;
+        // only the changed areas when dirty tiles are enabled (see fbg_setDirtyTiles)
+        struct _fbg_bbox *rects = NULL;
+        int rects_count = fbg_getPresentRects(fbg, &rects);
 
+        if (rects_count >= 0) {
             int i = 0;
-
-            for (i = 0; i < fbg->width_n_height; i += 1) {
-                unsigned int v = ((*pix_pointer_src++ >> 3) & 0x1f);
-                v |= ((*pix_pointer_src++ >> 2) & 0x3f) << 5;
-                v |= ((*pix_pointer_src++ >> 3) & 0x1f) << 11;
-
-                *pix_pointer_dst++ = v;
-                *pix_pointer_dst++ = v >> 8;;
+            for (i = 0; i < rects_count; i += 1) {
+                fbg_fbdevCopyArea(fbg, &rects[i]);
             }
+        } else if (fbdev_context->vinfo.bits_per_pixel == 16 || fbg->line_length != (int)fbdev_context->finfo.line_length) {
+            struct _fbg_bbox area = { 0, 0, fbg->width, fbg->height };
+
+            fbg_fbdevCopyArea(fbg, &area);
         } else {
             memcpy(fbdev_context->buffer, fbg->disp_buffer, fbg->size);
         }
     }
 }
 
+#ifdef FBG_PARALLEL
+uint64_t fbg_fbdevTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// triple buffering present thread : wait for a queued page, pan the display to it then wait for the vertical sync so that the page is visible when published
+void *fbg_fbdevPresent(void *data) {
+    struct _fbg *fbg = (struct _fbg *)data;
+    struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
+
+    // owned by this thread
+    struct fb_var_screeninfo vinfo = fbdev_context->vinfo;
+
+    pthread_mutex_lock(&fbdev_context->present_mutex);
+
+    while (1) {
+        while (fbdev_context->present_running && fbdev_context->queued_page < 0) {
+            pthread_cond_wait(&fbdev_context->present_cond, &fbdev_context->present_mutex);
+        }
+
+        if (!fbdev_context->present_running) {
+            break;
+        }
+
+        int page = fbdev_context->queued_page;
+
+        pthread_mutex_unlock(&fbdev_context->present_mutex);
+
+        vinfo.yoffset = page * fbg->height;
+
+        if (ioctl(fbdev_context->fd, FBIOPAN_DISPLAY, &vinfo) == -1) {
+            fprintf(stderr, "fbg_fbdevPresent: FBIOPAN_DISPLAY failed!\n");
+        }
+
+        // the pan take effect at the next vertical blank : the previous page is scanned out till then so it is only given back afterward
+#ifdef FBIO_WAITFORVSYNC
+        int dummy = 0;
+        ioctl(fbdev_context->fd, FBIO_WAITFORVSYNC, &dummy);
+#endif
+
+        uint64_t now = fbg_fbdevTimeNs();
+
+        pthread_mutex_lock(&fbdev_context->present_mutex);
+
+        struct _fbg_fbdev_present_stats *stats = &fbdev_context->present_stats;
+
+        stats->presented += 1;
+        stats->latency = now - fbdev_context->queued_time;
+        stats->max_latency = (stats->latency > stats->max_latency) ? stats->latency : stats->max_latency;
+        stats->average_latency = (int64_t)stats->average_latency + ((int64_t)stats->latency - (int64_t)stats->average_latency) / (int64_t)stats->presented;
+
+        fbdev_context->displayed_page = page;
+        fbdev_context->queued_page = -1;
+
+        pthread_cond_broadcast(&fbdev_context->present_cond);
+    }
+
+    pthread_mutex_unlock(&fbdev_context->present_mutex);
+
+    return NULL;
+}
+
+int fbg_fbdevStartPresent(struct _fbg *fbg) {
+    struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
+
+    fbdev_context->displayed_page = 0;
+    fbdev_context->queued_page = -1;
+    fbdev_context->draw_page = 1;
+    fbdev_context->present_running = 1;
+
+    if (pthread_mutex_init(&fbdev_context->present_mutex, NULL) != 0) {
+        fprintf(stderr, "fbg_fbdevStartPresent: pthread_mutex_init failed!\n");
+
+        return 0;
+    }
+
+    if (pthread_cond_init(&fbdev_context->present_cond, NULL) != 0) {
+        fprintf(stderr, "fbg_fbdevStartPresent: pthread_cond_init failed!\n");
+
+        pthread_mutex_destroy(&fbdev_context->present_mutex);
+
+        return 0;
+    }
+
+    if (pthread_create(&fbdev_context->present_thread, NULL, fbg_fbdevPresent, fbg) != 0) {
+        fprintf(stderr, "fbg_fbdevStartPresent: pthread_create failed!\n");
+
+        pthread_cond_destroy(&fbdev_context->present_cond);
+        pthread_mutex_destroy(&fbdev_context->present_mutex);
+
+        return 0;
+    }
+
+    return 1;
+}
+
+// queue the drawn page for the present thread and draw the next frame into the free page
+void fbg_fbdevQueuePage(struct _fbg *fbg) {
+    struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
+
+    int page_size = fbg->size;
+
+    pthread_mutex_lock(&fbdev_context->present_mutex);
+
+    // the previous frame is not displayed yet : no free page
+    if (fbdev_context->queued_page >= 0) {
+        uint64_t wait_start = fbg_fbdevTimeNs();
+
+        while (fbdev_context->queued_page >= 0) {
+            pthread_cond_wait(&fbdev_context->present_cond, &fbdev_context->present_mutex);
+        }
+
+        fbdev_context->present_stats.waits += 1;
+        fbdev_context->present_stats.wait_time += fbg_fbdevTimeNs() - wait_start;
+    }
+
+    int queued_page = fbdev_context->draw_page;
+
+    fbdev_context->queued_page = queued_page;
+    fbdev_context->queued_time = fbg_fbdevTimeNs();
+
+    // pages are 0, 1 and 2 : the one neither displayed nor queued
+    fbdev_context->draw_page = 3 - fbdev_context->displayed_page - queued_page;
+
+    pthread_cond_broadcast(&fbdev_context->present_cond);
+
+    pthread_mutex_unlock(&fbdev_context->present_mutex);
+
+    fbg->disp_buffer = fbdev_context->buffer + queued_page * page_size;
+    fbg->back_buffer = fbdev_context->buffer + fbdev_context->draw_page * page_size;
+}
+
+int fbg_fbdevGetPresentStats(struct _fbg *fbg, struct _fbg_fbdev_present_stats *stats) {
+    struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
+
+    if (!fbdev_context->triple_buffering) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&fbdev_context->present_mutex);
+
+    *stats = fbdev_context->present_stats;
+
+    pthread_mutex_unlock(&fbdev_context->present_mutex);
+
+    return 1;
+}
+#endif
+
 void fbg_fbdevFlip(struct _fbg *fbg) {
     struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
-    
+
+#ifdef FBG_PARALLEL
+    if (fbdev_context->triple_buffering) {
+        fbg_fbdevQueuePage(fbg);
+
+        return;
+    }
+#endif
+
     if (fbdev_context->page_flipping) {
         if (fbdev_context->vinfo.yoffset == 0) {
             fbdev_context->vinfo.yoffset = fbg->height;
@@ -237,10 +637,22 @@ void fbg_fbdevFlip(struct _fbg *fbg) {
 void fbg_fbdevFree(struct _fbg *fbg) {
     struct _fbg_fbdev_context *fbdev_context = fbg->user_context;
 
-    if (!fbdev_context->page_flipping) {
-        free(fbg->back_buffer);
-        free(fbg->disp_buffer);
+#ifdef FBG_PARALLEL
+    if (fbdev_context->triple_buffering) {
+        pthread_mutex_lock(&fbdev_context->present_mutex);
+
+        fbdev_context->present_running = 0;
+
+        pthread_cond_broadcast(&fbdev_context->present_cond);
+
+        pthread_mutex_unlock(&fbdev_context->present_mutex);
+
+        pthread_join(fbdev_context->present_thread, NULL);
+
+        pthread_cond_destroy(&fbdev_context->present_cond);
+        pthread_mutex_destroy(&fbdev_context->present_mutex);
     }
+#endif
 
     if (fbdev_context->buffer) {
         munmap(fbdev_context->buffer, fbdev_context->finfo.smem_len);
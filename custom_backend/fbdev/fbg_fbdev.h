@@ -31,6 +31,30 @@
     #include <linux/fb.h>
     #include "fbgraphics.h"
 
+    //! fbg_fbdevSetup() page flipping mode : no page flipping, the display buffer is copied to the framebuffer
+    #define FBG_FBDEV_SINGLE_BUFFERING 0
+    //! fbg_fbdevSetup() page flipping mode : two framebuffer pages, flips pan the display
+    #define FBG_FBDEV_DOUBLE_BUFFERING 1
+    //! fbg_fbdevSetup() page flipping mode : three framebuffer pages presented by a dedicated thread (FBG_PARALLEL only)
+    #define FBG_FBDEV_TRIPLE_BUFFERING 2
+
+    //! fbdev present statistics data structure
+    /*! Hold the triple buffering present thread counters (see fbg_fbdevGetPresentStats()) */
+    struct _fbg_fbdev_present_stats {
+        //! number of frames displayed by the present thread
+        uint64_t presented;
+        //! time between the last fbg_flip() call and the display of the frame (nanoseconds)
+        uint64_t latency;
+        //! average flip latency (nanoseconds)
+        uint64_t average_latency;
+        //! maximum flip latency (nanoseconds)
+        uint64_t max_latency;
+        //! number of fbg_flip() calls which waited for the previous frame to be displayed (rendering faster than the display)
+        uint64_t waits;
+        //! total time fbg_flip() waited (nanoseconds)
+        uint64_t wait_time;
+    };
+
     //! fbdev wrapper data structure
     struct _fbg_fbdev_context {
       //! Framebuffer device file descriptor
@@ -46,16 +70,62 @@
 
       //! Flag indicating that page flipping is enabled
       int page_flipping;
+      //! Flag indicating that triple buffering is enabled (three pages, present thread)
+      int triple_buffering;
+
+      //! Flag indicating that 16 bpp conversion use ordered dithering (see fbg_fbdevSetDithering())
+      int dithering;
+
+#ifdef FBG_PARALLEL
+      //! Present thread (triple buffering)
+      pthread_t present_thread;
+      //! Present thread state lock
+      pthread_mutex_t present_mutex;
+      //! Signaled when a frame is queued / displayed
+      pthread_cond_t present_cond;
+      //! 1 while the present thread runs
+      int present_running;
+      //! Page displayed
+      int displayed_page;
+      //! Page queued for display (-1 = none)
+      int queued_page;
+      //! Page drawn into
+      int draw_page;
+      //! Time of the fbg_flip() call which queued the page (nanoseconds, CLOCK_MONOTONIC)
+      uint64_t queued_time;
+      //! Present counters
+      struct _fbg_fbdev_present_stats present_stats;
+#endif
     };
 
     //! initialize a FB Graphics context (framebuffer)
+    //! note : with FBG_FBDEV_TRIPLE_BUFFERING the virtual height is tripled, fbg_flip() queue the drawn page and return immediately with a free page to draw the next frame into while a present thread pan the display and wait for the vertical sync (the page is displayed once it returns), fbg_flip() only wait when the previous frame is not displayed yet
     /*!
       \param fb_device framebuffer device (example : /dev/fb0)
-      \param page_flipping wether to use page flipping mechanism for double buffering (slow on some devices)
+      \param page_flipping one of FBG_FBDEV_*_BUFFERING (1 = double buffering), page flipping may be slow on some devices, triple buffering fall back to double buffering without FBG_PARALLEL
       \return _fbg structure pointer to pass to any FBG library functions
+      \sa fbg_fbdevGetPresentStats()
     */
     extern struct _fbg *fbg_fbdevSetup(char *fb_device, int page_flipping);
 
+#ifdef FBG_PARALLEL
+    //! get the triple buffering present thread counters (flip latency etc.)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param stats pointer to a _fbg_fbdev_present_stats data structure which receive the counters
+      \return 1 on success, 0 when triple buffering is not enabled
+    */
+    extern int fbg_fbdevGetPresentStats(struct _fbg *fbg, struct _fbg_fbdev_present_stats *stats);
+#endif
+
+    //! enable / disable 4x4 ordered dithering when converting to a 16 bpp framebuffer (smooth gradients instead of banding)
+    //! note : the conversion use SSE2 / NEON instructions when enabled on the context (see fbg_setSIMD())
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param enable 1 to enable, 0 to disable (default)
+    */
+    extern void fbg_fbdevSetDithering(struct _fbg *fbg, int enable);
+
     //! initialize a FB Graphics context with '/dev/fb0' as framebuffer device and no page flipping
     #define fbg_fbdevInit() fbg_fbdevSetup(NULL, 0)
 #endif
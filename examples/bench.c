@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fbgraphics.h"
+
+// hot primitives benchmark, it render into memory buffers (no display needed)
+// build it both ways with "make bench" : ./bench (default) and ./bench_inline (FBG_INLINE) then compare
+// usage : ./bench [width] [height] [frames]
+
+static double now_ms() {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static void benchPixel(struct _fbg *fbg) {
+    int x, y;
+    for (y = 0; y < fbg->height; y += 1) {
+        for (x = 0; x < fbg->width; x += 1) {
+            fbg_pixel(fbg, x, y, x, y, 127);
+        }
+    }
+}
+
+static void benchRect(struct _fbg *fbg) {
+    int x, y;
+    for (y = 0; y < fbg->height - 1; y += 2) {
+        for (x = 0; x < fbg->width - 1; x += 2) {
+            fbg_rect(fbg, x, y, 2, 2, x, y, 127);
+        }
+    }
+}
+
+static void benchLine(struct _fbg *fbg) {
+    int y;
+    for (y = 0; y < fbg->height; y += 1) {
+        fbg_line(fbg, 0, y, fbg->width - 1, fbg->height - 1 - y, y, 255 - y, 127);
+    }
+}
+
+static void benchPixela(struct _fbg *fbg) {
+    int x, y;
+    for (y = 0; y < fbg->height; y += 1) {
+        for (x = 0; x < fbg->width; x += 1) {
+            fbg_pixela(fbg, x, y, x, y, 127, 127);
+        }
+    }
+}
+
+static void run(const char *name, struct _fbg *fbg, void (*bench)(struct _fbg *fbg), int frames) {
+    int i;
+
+    bench(fbg); // warm up
+
+    double start = now_ms();
+
+    for (i = 0; i < frames; i += 1) {
+        bench(fbg);
+    }
+
+    double elapsed = now_ms() - start;
+
+    printf("%d components %-7s %.3f ms/frame\n", fbg->components, name, elapsed / frames);
+}
+
+int main(int argc, char* argv[]) {
+    int width = (argc > 1) ? atoi(argv[1]) : 640;
+    int height = (argc > 2) ? atoi(argv[2]) : 480;
+    int frames = (argc > 3) ? atoi(argv[3]) : 200;
+
+    int components;
+
+#ifdef FBG_INLINE
+    printf("FBG_INLINE, %dx%d, %d frames\n", width, height, frames);
+#else
+    printf("default, %dx%d, %d frames\n", width, height, frames);
+#endif
+
+    for (components = 3; components <= 4; components += 1) {
+        struct _fbg *fbg = fbg_customSetup(width, height, components, 1, 0, NULL, NULL, NULL, NULL, NULL);
+        if (fbg == NULL) {
+            return 1;
+        }
+
+        run("pixel", fbg, benchPixel, frames);
+        run("rect", fbg, benchRect, frames);
+        run("line", fbg, benchLine, frames);
+        run("pixela", fbg, benchPixela, frames);
+
+        fbg_close(fbg);
+    }
+
+    return 0;
+}
@@ -42,19 +42,6 @@ void fragment(struct _fbg *fbg, void *data) {
     }
 }
 
-void alphaBlending(struct _fbg *fbg, unsigned char *buffer, int task_id) {
-    int alpha = 164; // the layers alpha blend amount
-
-    if (task_id == 1) {
-        alpha = 128;
-    }
-
-    int j = 0;
-    for (j = 0; j < fbg->size; j += 1) {
-        fbg->back_buffer[j] = (buffer[j] > 0) ? ((alpha * buffer[j] + (255 - alpha) * fbg->back_buffer[j]) >> 8) : fbg->back_buffer[j];
-    }
-}
-
 int main(int argc, char* argv[]) {
     struct _fbg *fbg = fbg_fbdevInit();
     if (fbg == NULL) {
@@ -70,13 +57,17 @@ int main(int argc, char* argv[]) {
 
     fbg_createFragment(fbg, NULL, fragment, NULL, 2);
 
+    // layers are alpha blended with the background, black pixels (default colorkey) are left out
+    fbg_setMixing(fbg, 1, FBG_MIXING_ALPHA_COLORKEY, 128);
+    fbg_setMixing(fbg, 2, FBG_MIXING_ALPHA_COLORKEY, 164);
+
     do {
         fbg_clear(fbg, 0);
 
         fbg_imageClip(fbg, texture, 0, 0, 0, 0, _FBG_MIN(fbg->width, texture->width), _FBG_MIN(fbg->height, texture->height));
 
-        // we draw with alpha blending function to mix our layer with the background
-        fbg_draw(fbg, alphaBlending);
+        // we draw with the built-in mixing (set with fbg_setMixing) to mix our layers with the background
+        fbg_draw(fbg, NULL);
 
         // draw fps
         fbg_write(fbg, "FBGraphics: Compositing", 4, 2);
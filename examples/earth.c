@@ -187,13 +187,6 @@ void fragment(struct _fbg *fbg, void *user_data) {
     ud->ymotion -= 0.25;
 }
 
-void selectiveMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
-    int j = 0;
-    for (j = 0; j < fbg->size; j += 1) {
-        fbg->back_buffer[j] = (fbg->back_buffer[j] > buffer[j]) ? fbg->back_buffer[j] : buffer[j];
-    }
-}
-
 int main(int argc, char* argv[]) {
     struct _fbg *fbg = fbg_fbdevInit();
     if (fbg == NULL) {
@@ -220,7 +213,7 @@ int main(int argc, char* argv[]) {
 
         fragment(fbg, user_data);
 
-        fbg_draw(fbg, selectiveMixing);
+        fbg_draw(fbg, fbg_maxMixing);
 
         fbg_rect(fbg, 0, 2, 8 * 19, 8 * 9 - 4, 0, 0, 0);
         fbg_write(fbg, "FBGraphics: Earth", 4, 2);
@@ -79,13 +79,6 @@ void fragment(struct _fbg *fbg, void *user_data) {
     ud->ymotion += 0.05;
 }
 
-void selectiveMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
-    int j = 0;
-    for (j = 0; j < fbg->size; j += 1) {
-        fbg->back_buffer[j] = (fbg->back_buffer[j] > buffer[j]) ? fbg->back_buffer[j] : buffer[j];
-    }
-}
-
 int main(int argc, char* argv[]) {
     struct _fbg *fbg = fbg_fbdevInit();
     if (fbg == NULL) {
@@ -106,7 +99,8 @@ int main(int argc, char* argv[]) {
     do {
         fragment(fbg, user_data);
 
-        fbg_draw(fbg, selectiveMixing);
+        // keep the brightest components of each layers
+        fbg_draw(fbg, fbg_maxMixing);
 
         fbg_write(fbg, "FBGraphics: Flags of the world", 4, 2);
 
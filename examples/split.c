@@ -0,0 +1,109 @@
+#include <sys/stat.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fbg_fbdev.h"
+
+int keep_running = 1;
+
+void int_handler(int dummy) {
+    keep_running = 0;
+}
+
+struct _fragment_user_data {
+    float motion;
+};
+
+void *fragmentStart(struct _fbg *fbg) {
+    struct _fragment_user_data *user_data = (struct _fragment_user_data *)calloc(1, sizeof(struct _fragment_user_data));
+
+    user_data->motion = 0.0f;
+
+    return user_data;
+}
+
+void fragmentStop(struct _fbg *fbg, void *data) {
+    struct _fragment_user_data *ud = (struct _fragment_user_data *)data;
+
+    free(ud);
+}
+
+// per-pixel plasma, each fragment only draw its own tile of the display back buffer (no mixing)
+void fragment(struct _fbg *fbg, void *user_data) {
+    struct _fragment_user_data *ud = (struct _fragment_user_data *)user_data;
+
+    // fbg->width / fbg->height are the tile dimensions, fbg->region give the tile position within the display
+    float cx = fbg->region.display_width / 2.0f;
+    float cy = fbg->region.display_height / 2.0f;
+
+    int x = 0, y = 0;
+    for (y = 0; y < fbg->height; y += 1) {
+        // rows are fbg->line_length bytes apart (tile rows are display rows)
+        unsigned char *pix_pointer = fbg->back_buffer + y * fbg->line_length;
+
+        float dy = fbg->region.y + y * fbg->region.row_step - cy;
+
+        for (x = 0; x < fbg->width; x += 1) {
+            float dx = fbg->region.x + x - cx;
+
+            float v = sinf(dx * 0.02f + ud->motion) + sinf(dy * 0.03f - ud->motion) + sinf(sqrtf(dx * dx + dy * dy) * 0.04f - ud->motion * 2.0f);
+
+            *pix_pointer++ = (unsigned char)(127.0f + 127.0f * sinf(v * M_PI));
+            *pix_pointer++ = (unsigned char)(127.0f + 127.0f * cosf(v * M_PI));
+            *pix_pointer++ = (unsigned char)(fbg->task_id * 48);
+            pix_pointer += fbg->comp_offset;
+        }
+    }
+
+    ud->motion += 0.05f;
+}
+
+int main(int argc, char* argv[]) {
+    struct _fbg *fbg = fbg_fbdevInit();
+    if (fbg == NULL) {
+        return 0;
+    }
+
+    signal(SIGINT, int_handler);
+
+    struct _fbg_img *bbimg = fbg_loadPNG(fbg, "bbmode1_8x8.png");
+
+    struct _fbg_font *bbfont = fbg_createFont(fbg, bbimg, 8, 8, 33);
+
+    // each fragments draw directly into a tile of the display back buffer
+    fbg_setFragmentSplit(fbg, FBG_SPLIT_TILES, 0);
+
+    fbg_createFragment(fbg, fragmentStart, fragment, fragmentStop, 4);
+
+    do {
+        // wait for all tiles to be drawn
+        fbg_draw(fbg, NULL);
+
+        // overlays can be drawn between fbg_draw and fbg_flip
+        fbg_rect(fbg, 0, 2, 8 * 19, 8 * 10 - 2, 0, 0, 0);
+        fbg_write(fbg, "FBGraphics: Split", 4, 2);
+
+        fbg_write(fbg, "FPS", 4, 12+8);
+        fbg_write(fbg, "#0 (Main): ", 4, 22+8);
+        fbg_write(fbg, "#1: ", 4, 32+8);
+        fbg_write(fbg, "#2: ", 4, 32+8+2+8);
+        fbg_write(fbg, "#3: ", 4, 32+16+4+8);
+        fbg_write(fbg, "#4: ", 4, 32+24+6+8);
+        fbg_drawFramerate(fbg, NULL, 0, 4 + 32 + 48 + 8, 22 + 8, 255, 255, 255);
+        fbg_drawFramerate(fbg, NULL, 1, 4+32, 32+8, 255, 255, 255);
+        fbg_drawFramerate(fbg, NULL, 2, 4+32, 32+8+2+8, 255, 255, 255);
+        fbg_drawFramerate(fbg, NULL, 3, 4+32, 32+16+4+8, 255, 255, 255);
+        fbg_drawFramerate(fbg, NULL, 4, 4+32, 32+24+6+8, 255, 255, 255);
+
+        // fragments start drawing the next frame once flipped
+        fbg_flip(fbg);
+    } while (keep_running);
+
+    fbg_close(fbg);
+
+    fbg_freeImage(bbimg);
+    fbg_freeFont(bbfont);
+
+    return 0;
+}
@@ -116,13 +116,6 @@ void fragment(struct _fbg *fbg, void *user_data) {
     ud->rmotion += 0.006;
 }
 
-void selectiveMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
-    int j = 0;
-    for (j = 0; j < fbg->size; j += 1) {
-        fbg->back_buffer[j] = (fbg->back_buffer[j] > buffer[j]) ? fbg->back_buffer[j] : buffer[j];
-    }
-}
-
 int main(int argc, char* argv[]) {
     struct _fbg *fbg = fbg_fbdevInit();
     if (fbg == NULL) {
@@ -138,6 +131,9 @@ int main(int argc, char* argv[]) {
 
     fbg_createFragment(fbg, fragmentStart, fragment, fragmentStop, 3);
 
+    // mix fragments output in parallel (4 stripes : 3 fragments threads + this thread)
+    fbg_setMixingStripes(fbg, 4);
+
     struct _fragment_user_data *user_data = fragmentStart(fbg);
 
     do {
@@ -145,7 +141,8 @@ int main(int argc, char* argv[]) {
 
         fragment(fbg, user_data);
 
-        fbg_draw(fbg, selectiveMixing);
+        // keep the brightest components of each layers
+        fbg_draw(fbg, fbg_maxMixing);
 
         fbg_rect(fbg, 0, 2, 8 * 19, 8 * 9 - 4, 0, 0, 0);
         fbg_write(fbg, "FBGraphics: Tunnel", 4, 2);
@@ -44,1018 +44,4579 @@
 #include "stb/stb_image.h"
 #endif
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// the library always provide the out-of-line hot primitives, FBG_INLINE only apply to the code including fbgraphics.h
+#undef FBG_INLINE
+#define FBG_PRIMITIVES_IMPLEMENTATION
 #include "fbgraphics.h"
 
+// SIMD kernels are only built with GCC compatible compilers (target attributes / builtins), they can be disabled with WITHOUT_SIMD
+#if !defined(WITHOUT_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define FBG_SIMD_X86
+    #include <immintrin.h>
+#endif
+
+#if !defined(WITHOUT_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    #define FBG_SIMD_ARM
+    #include <arm_neon.h>
+#endif
+
+#include <errno.h>
+
+struct _fbg_tiles *fbg_allocTiles(int width, int height);
+uint64_t fbg_timeNs();
+
 #ifdef FBG_PARALLEL
+
+    #ifdef __linux__
+        #include <limits.h>
+        #include <unistd.h>
+        #include <sys/syscall.h>
+        #include <linux/futex.h>
+    #endif
+
     void fbg_terminateFragments(struct _fbg *fbg);
     void fbg_freeTasks(struct _fbg *fbg);
+    void fbg_parkFragments(struct _fbg *fbg);
+    void fbg_updateFragments(struct _fbg *fbg, void *(*user_fragment_start)(struct _fbg *fbg), void (*user_fragment)(struct _fbg *fbg, void *user_data), void (*user_fragment_stop)(struct _fbg *fbg, void *user_data), unsigned int parallel_tasks, int restart);
+    void fbg_wakeSync(struct _fbg_sync *sync);
+    void fbg_setSync(struct _fbg_sync *sync, int value);
+    void fbg_waitSync(struct _fbg_sync *sync, int expected, atomic_int *state, int spin_time, struct _fbg_pool *pool, atomic_uint_fast64_t *wait_time, atomic_uint_fast64_t *wait_sleeps);
+    void fbg_wakeFragment(struct _fbg_fragment *fragment);
+    void fbg_freeFragmentBuffers(struct _fbg_fragment *fragment);
+    void fbg_trimBuffers(struct _fbg_buffer_pool *buffer_pool, size_t needed);
+    size_t fbg_bufferClass(size_t size);
+    int fbg_helpJobs(struct _fbg_pool *pool);
+    void fbg_createWorkers(struct _fbg *fbg, unsigned int count);
+    void fbg_releasePool(struct _fbg_pool *pool);
+    void fbg_releaseBufferPool(struct _fbg_buffer_pool *buffer_pool);
+    void fbg_submitFragments(struct _fbg *fbg);
+    void fbg_paceFrame(struct _fbg *fbg);
+    void fbg_initThreadAttr(struct _fbg *fbg, pthread_attr_t *attr, int task_id);
+    void fbg_applyThreadSettings(struct _fbg *fbg, pthread_t thread, int task_id, int index);
+    void fbg_resetAdaptiveWindow(struct _fbg *fbg);
+    void fbg_adaptFragments(struct _fbg *fbg, uint64_t flip_start, uint64_t flip_end);
+
+#endif
 
-    #ifdef FBG_LFDS
-    void fbg_freelistCleanup(struct lfds720_freelist_n_state *fs, struct lfds720_freelist_n_element *fe) {
-        struct _fbg_freelist_data *freelist_data;
-        freelist_data = LFDS720_FREELIST_N_GET_VALUE_FROM_ELEMENT(*fe);
+int fbg_detectSIMD() {
+    int simd = FBG_SIMD_NONE;
 
-        free(freelist_data->buffer);
+#ifdef FBG_SIMD_X86
+    __builtin_cpu_init();
 
-        freelist_data->buffer = NULL;
+    if (__builtin_cpu_supports("sse2")) {
+        simd |= FBG_SIMD_SSE2;
     }
 
-    void fbg_ringbufferCleanup(struct lfds720_ringbuffer_n_state *rs, void *key, void *value, enum lfds720_misc_flag unread_flag) {
-
+    if (__builtin_cpu_supports("avx2")) {
+        simd |= FBG_SIMD_AVX2;
     }
-    #endif
 #endif
 
-struct _fbg *fbg_customSetup(
-        int width, int height,
-        int components,
-        int initialize_buffers,
-        int allow_resizing,
-        void *user_context,
-        void (*user_draw)(struct _fbg *fbg),
-        void (*user_flip)(struct _fbg *fbg),
-        void (*backend_resize)(struct _fbg *fbg, unsigned int new_width, unsigned int new_height),
-        void (*user_free)(struct _fbg *fbg)) {
-    struct _fbg *fbg = (struct _fbg *)calloc(1, sizeof(struct _fbg));
-    if (!fbg) {
-        fprintf(stderr, "fbg_customSetup: fbg calloc failed!\n");
+#ifdef FBG_SIMD_ARM
+    simd |= FBG_SIMD_NEON;
+#endif
 
-        return NULL;
+    return simd;
+}
+
+void fbg_additiveKernel(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j < size; j += 1) {
+        dst[j] = _FBG_MIN(dst[j] + src[j], 255);
     }
+}
 
-    fbg->user_flip = user_flip;
-    fbg->user_draw = user_draw;
-    fbg->user_free = user_free;
-    fbg->backend_resize = backend_resize;
+void fbg_subtractKernel(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j < size; j += 1) {
+        dst[j] = _FBG_MAX(dst[j] - src[j], 0);
+    }
+}
 
-    fbg->width = width;
-    fbg->height = height;
+void fbg_alphaKernel(unsigned char *dst, const unsigned char *src, int size, int alpha) {
+    int j = 0;
+    for (j = 0; j < size; j += 1) {
+        dst[j] = (alpha * src[j] + (255 - alpha) * dst[j]) >> 8;
+    }
+}
 
-    fbg->components = components;
-    fbg->comp_offset = components - 3;
+void fbg_maxKernel(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j < size; j += 1) {
+        dst[j] = _FBG_MAX(dst[j], src[j]);
+    }
+}
 
-    fbg->line_length = fbg->width * fbg->components;
+void fbg_multiplyKernel(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j < size; j += 1) {
+        dst[j] = _FBG_MUL255(dst[j], src[j]);
+    }
+}
 
-    fbg->width_n_height = fbg->width * fbg->height;
+void fbg_screenKernel(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j < size; j += 1) {
+        dst[j] = 255 - _FBG_MUL255(255 - dst[j], 255 - src[j]);
+    }
+}
 
-    fbg->size = fbg->width * fbg->height * fbg->components;
+void fbg_colorkeyKernel(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key) {
+    int j = 0;
+    for (j = 0; j < size; j += components) {
+        if (src[j] == key.r && src[j + 1] == key.g && src[j + 2] == key.b) {
+            continue;
+        }
 
-    fbg->user_context = user_context;
+        memcpy(&dst[j], &src[j], components);
+    }
+}
 
-    if (initialize_buffers) {
-        fbg->back_buffer = calloc(1, fbg->size * sizeof(char));
-        if (!fbg->back_buffer) {
-            fprintf(stderr, "fbg_customSetup: back_buffer calloc failed!\n");
+void fbg_alphaColorkeyKernel(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key, int alpha) {
+    int j = 0;
+    for (j = 0; j < size; j += components) {
+        if (src[j] == key.r && src[j + 1] == key.g && src[j + 2] == key.b) {
+            continue;
+        }
 
-            user_free(fbg);
+        fbg_alphaKernel(&dst[j], &src[j], components, alpha);
+    }
+}
 
-            free(fbg);
+#ifdef FBG_SIMD_X86
+__attribute__((target("sse2")))
+void fbg_subtractKernelSSE2(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 64 <= size; j += 64) {
+        __m128i d0 = _mm_loadu_si128((__m128i *)(dst + j));
+        __m128i d1 = _mm_loadu_si128((__m128i *)(dst + j + 16));
+        __m128i d2 = _mm_loadu_si128((__m128i *)(dst + j + 32));
+        __m128i d3 = _mm_loadu_si128((__m128i *)(dst + j + 48));
+
+        _mm_storeu_si128((__m128i *)(dst + j), _mm_subs_epu8(d0, _mm_loadu_si128((__m128i *)(src + j))));
+        _mm_storeu_si128((__m128i *)(dst + j + 16), _mm_subs_epu8(d1, _mm_loadu_si128((__m128i *)(src + j + 16))));
+        _mm_storeu_si128((__m128i *)(dst + j + 32), _mm_subs_epu8(d2, _mm_loadu_si128((__m128i *)(src + j + 32))));
+        _mm_storeu_si128((__m128i *)(dst + j + 48), _mm_subs_epu8(d3, _mm_loadu_si128((__m128i *)(src + j + 48))));
+    }
 
-            return NULL;
-        }
+    for (; j + 16 <= size; j += 16) {
+        __m128i d = _mm_loadu_si128((__m128i *)(dst + j));
 
-        fbg->disp_buffer = calloc(1, fbg->size * sizeof(char));
-        if (!fbg->disp_buffer) {
-            fprintf(stderr, "fbg_customSetup: disp_buffer calloc failed!\n");
+        _mm_storeu_si128((__m128i *)(dst + j), _mm_subs_epu8(d, _mm_loadu_si128((__m128i *)(src + j))));
+    }
 
-            user_free(fbg);
+    fbg_subtractKernel(dst + j, src + j, size - j);
+}
 
-            free(fbg->back_buffer);
-            free(fbg);
+__attribute__((target("sse2")))
+void fbg_additiveKernelSSE2(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 64 <= size; j += 64) {
+        __m128i d0 = _mm_loadu_si128((__m128i *)(dst + j));
+        __m128i d1 = _mm_loadu_si128((__m128i *)(dst + j + 16));
+        __m128i d2 = _mm_loadu_si128((__m128i *)(dst + j + 32));
+        __m128i d3 = _mm_loadu_si128((__m128i *)(dst + j + 48));
+
+        _mm_storeu_si128((__m128i *)(dst + j), _mm_adds_epu8(d0, _mm_loadu_si128((__m128i *)(src + j))));
+        _mm_storeu_si128((__m128i *)(dst + j + 16), _mm_adds_epu8(d1, _mm_loadu_si128((__m128i *)(src + j + 16))));
+        _mm_storeu_si128((__m128i *)(dst + j + 32), _mm_adds_epu8(d2, _mm_loadu_si128((__m128i *)(src + j + 32))));
+        _mm_storeu_si128((__m128i *)(dst + j + 48), _mm_adds_epu8(d3, _mm_loadu_si128((__m128i *)(src + j + 48))));
+    }
 
-            return NULL;
+    for (; j + 16 <= size; j += 16) {
+        __m128i d = _mm_loadu_si128((__m128i *)(dst + j));
+
+        _mm_storeu_si128((__m128i *)(dst + j), _mm_adds_epu8(d, _mm_loadu_si128((__m128i *)(src + j))));
+    }
+
+    fbg_additiveKernel(dst + j, src + j, size - j);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i fbg_alphaSSE2(__m128i s, __m128i d, __m128i alpha, __m128i ialpha) {
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), alpha), _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ialpha));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), alpha), _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ialpha));
+
+    return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+// SSE2 version of _FBG_MUL255
+__attribute__((target("sse2")))
+static inline __m128i fbg_mul255SSE2(__m128i a, __m128i b) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i half = _mm_set1_epi16(128);
+
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)), half);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)), half);
+
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+    return _mm_packus_epi16(lo, hi);
+}
+
+// compute the colorkey mask of 16 pixels of 3 components (48 bytes) : 0xff for all bytes of pixels matching the key
+__attribute__((target("sse2")))
+static inline void fbg_colorkeyMask3SSE2(const unsigned char *src, const __m128i key_pattern[3], const __m128i pixel_start[3], __m128i mask[3]) {
+    __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)(src)), key_pattern[0]);
+    __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)(src + 16)), key_pattern[1]);
+    __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)(src + 32)), key_pattern[2]);
+
+    // match of the 3 components (first byte of each pixels)
+    __m128i f0 = _mm_and_si128(_mm_and_si128(e0, pixel_start[0]), _mm_and_si128(_mm_or_si128(_mm_srli_si128(e0, 1), _mm_slli_si128(e1, 15)), _mm_or_si128(_mm_srli_si128(e0, 2), _mm_slli_si128(e1, 14))));
+    __m128i f1 = _mm_and_si128(_mm_and_si128(e1, pixel_start[1]), _mm_and_si128(_mm_or_si128(_mm_srli_si128(e1, 1), _mm_slli_si128(e2, 15)), _mm_or_si128(_mm_srli_si128(e1, 2), _mm_slli_si128(e2, 14))));
+    __m128i f2 = _mm_and_si128(_mm_and_si128(e2, pixel_start[2]), _mm_and_si128(_mm_srli_si128(e2, 1), _mm_srli_si128(e2, 2)));
+
+    // spread it over the pixel bytes
+    mask[0] = _mm_or_si128(f0, _mm_or_si128(_mm_slli_si128(f0, 1), _mm_slli_si128(f0, 2)));
+    mask[1] = _mm_or_si128(_mm_or_si128(f1, _mm_or_si128(_mm_slli_si128(f1, 1), _mm_slli_si128(f1, 2))), _mm_or_si128(_mm_srli_si128(f0, 15), _mm_srli_si128(f0, 14)));
+    mask[2] = _mm_or_si128(_mm_or_si128(f2, _mm_or_si128(_mm_slli_si128(f2, 1), _mm_slli_si128(f2, 2))), _mm_or_si128(_mm_srli_si128(f1, 15), _mm_srli_si128(f1, 14)));
+}
+
+__attribute__((target("sse2")))
+void fbg_alphaKernelSSE2(unsigned char *dst, const unsigned char *src, int size, int alpha) {
+    __m128i a = _mm_set1_epi16(alpha);
+    __m128i ia = _mm_set1_epi16(255 - alpha);
+
+    int j = 0;
+    for (j = 0; j + 16 <= size; j += 16) {
+        __m128i d = _mm_loadu_si128((__m128i *)(dst + j));
+        __m128i s = _mm_loadu_si128((__m128i *)(src + j));
+
+        _mm_storeu_si128((__m128i *)(dst + j), fbg_alphaSSE2(s, d, a, ia));
+    }
+
+    fbg_alphaKernel(dst + j, src + j, size - j, alpha);
+}
+
+__attribute__((target("sse2")))
+void fbg_maxKernelSSE2(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 16 <= size; j += 16) {
+        __m128i d = _mm_loadu_si128((__m128i *)(dst + j));
+
+        _mm_storeu_si128((__m128i *)(dst + j), _mm_max_epu8(d, _mm_loadu_si128((__m128i *)(src + j))));
+    }
+
+    fbg_maxKernel(dst + j, src + j, size - j);
+}
+
+__attribute__((target("sse2")))
+void fbg_multiplyKernelSSE2(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 16 <= size; j += 16) {
+        __m128i d = _mm_loadu_si128((__m128i *)(dst + j));
+
+        _mm_storeu_si128((__m128i *)(dst + j), fbg_mul255SSE2(d, _mm_loadu_si128((__m128i *)(src + j))));
+    }
+
+    fbg_multiplyKernel(dst + j, src + j, size - j);
+}
+
+__attribute__((target("sse2")))
+void fbg_screenKernelSSE2(unsigned char *dst, const unsigned char *src, int size) {
+    __m128i ones = _mm_set1_epi8(-1);
+
+    int j = 0;
+    for (j = 0; j + 16 <= size; j += 16) {
+        __m128i d = _mm_xor_si128(_mm_loadu_si128((__m128i *)(dst + j)), ones);
+        __m128i s = _mm_xor_si128(_mm_loadu_si128((__m128i *)(src + j)), ones);
+
+        _mm_storeu_si128((__m128i *)(dst + j), _mm_xor_si128(fbg_mul255SSE2(d, s), ones));
+    }
+
+    fbg_screenKernel(dst + j, src + j, size - j);
+}
+
+// copy (alpha < 0) or alpha blend src pixels which does not match the colorkey
+__attribute__((target("sse2")))
+static inline void fbg_colorkeySSE2(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key, int alpha) {
+    __m128i a = _mm_set1_epi16(alpha);
+    __m128i ia = _mm_set1_epi16(255 - alpha);
+
+    int j = 0;
+    if (components == 4) {
+        __m128i key_pattern = _mm_set1_epi32(key.r | (key.g << 8) | (key.b << 16));
+        __m128i rgb_mask = _mm_set1_epi32(0x00ffffff);
+
+        for (j = 0; j + 16 <= size; j += 16) {
+            __m128i d = _mm_loadu_si128((__m128i *)(dst + j));
+            __m128i s = _mm_loadu_si128((__m128i *)(src + j));
+            __m128i m = _mm_cmpeq_epi32(_mm_and_si128(s, rgb_mask), key_pattern);
+
+            if (alpha >= 0) {
+                s = fbg_alphaSSE2(s, d, a, ia);
+            }
+
+            _mm_storeu_si128((__m128i *)(dst + j), _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, s)));
+        }
+    } else if (components == 3) {
+        __m128i key_pattern[3] = {
+            _mm_setr_epi8(key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r),
+            _mm_setr_epi8(key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g),
+            _mm_setr_epi8(key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b)
+        };
+
+        __m128i pixel_start[3] = {
+            _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1),
+            _mm_setr_epi8(0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0),
+            _mm_setr_epi8(0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0)
+        };
+
+        __m128i m[3];
+
+        for (j = 0; j + 48 <= size; j += 48) {
+            fbg_colorkeyMask3SSE2(src + j, key_pattern, pixel_start, m);
+
+            int k = 0;
+            for (k = 0; k < 3; k += 1) {
+                __m128i d = _mm_loadu_si128((__m128i *)(dst + j + k * 16));
+                __m128i s = _mm_loadu_si128((__m128i *)(src + j + k * 16));
+
+                if (alpha >= 0) {
+                    s = fbg_alphaSSE2(s, d, a, ia);
+                }
+
+                _mm_storeu_si128((__m128i *)(dst + j + k * 16), _mm_or_si128(_mm_and_si128(m[k], d), _mm_andnot_si128(m[k], s)));
+            }
         }
     }
 
-    fbg->initialize_buffers = initialize_buffers;
+    if (alpha >= 0) {
+        fbg_alphaColorkeyKernel(dst + j, src + j, size - j, components, key, alpha);
+    } else {
+        fbg_colorkeyKernel(dst + j, src + j, size - j, components, key);
+    }
+}
 
-    gettimeofday(&fbg->fps_start, NULL);
+__attribute__((target("sse2")))
+void fbg_colorkeyKernelSSE2(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key) {
+    fbg_colorkeySSE2(dst, src, size, components, key, -1);
+}
 
-    fbg_textColor(fbg, 255, 255, 255);
+__attribute__((target("sse2")))
+void fbg_alphaColorkeyKernelSSE2(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key, int alpha) {
+    fbg_colorkeySSE2(dst, src, size, components, key, alpha);
+}
 
-    fbg->allow_resizing = allow_resizing;
+__attribute__((target("avx2")))
+void fbg_additiveKernelAVX2(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 64 <= size; j += 64) {
+        __m256i d0 = _mm256_loadu_si256((__m256i *)(dst + j));
+        __m256i d1 = _mm256_loadu_si256((__m256i *)(dst + j + 32));
 
-#ifdef FBG_PARALLEL
-    fbg->state = 1;
-    fbg->frame = 0;
-    fbg->fps = 0;
+        _mm256_storeu_si256((__m256i *)(dst + j), _mm256_adds_epu8(d0, _mm256_loadu_si256((__m256i *)(src + j))));
+        _mm256_storeu_si256((__m256i *)(dst + j + 32), _mm256_adds_epu8(d1, _mm256_loadu_si256((__m256i *)(src + j + 32))));
+    }
 
-    fbg->tasks = 0;
+    for (; j + 32 <= size; j += 32) {
+        __m256i d = _mm256_loadu_si256((__m256i *)(dst + j));
 
-    fbg->fragment_queue_size = 7;
+        _mm256_storeu_si256((__m256i *)(dst + j), _mm256_adds_epu8(d, _mm256_loadu_si256((__m256i *)(src + j))));
+    }
+
+    fbg_additiveKernel(dst + j, src + j, size - j);
+}
 #endif
 
-    fbg->new_width = 0;
-    fbg->new_height = 0;
+#ifdef FBG_SIMD_ARM
+void fbg_subtractKernelNEON(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 64 <= size; j += 64) {
+        uint8x16_t d0 = vqsubq_u8(vld1q_u8(dst + j), vld1q_u8(src + j));
+        uint8x16_t d1 = vqsubq_u8(vld1q_u8(dst + j + 16), vld1q_u8(src + j + 16));
+        uint8x16_t d2 = vqsubq_u8(vld1q_u8(dst + j + 32), vld1q_u8(src + j + 32));
+        uint8x16_t d3 = vqsubq_u8(vld1q_u8(dst + j + 48), vld1q_u8(src + j + 48));
+
+        vst1q_u8(dst + j, d0);
+        vst1q_u8(dst + j + 16, d1);
+        vst1q_u8(dst + j + 32, d2);
+        vst1q_u8(dst + j + 48, d3);
+    }
 
-    return fbg;
+    for (; j + 16 <= size; j += 16) {
+        vst1q_u8(dst + j, vqsubq_u8(vld1q_u8(dst + j), vld1q_u8(src + j)));
+    }
+
+    fbg_subtractKernel(dst + j, src + j, size - j);
 }
 
-void fbg_setResizeCallback(struct _fbg *fbg, void (*user_resize)(struct _fbg *fbg, unsigned int new_width, unsigned int new_height)) {
-    fbg->user_resize = user_resize;
+void fbg_additiveKernelNEON(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 64 <= size; j += 64) {
+        uint8x16_t d0 = vqaddq_u8(vld1q_u8(dst + j), vld1q_u8(src + j));
+        uint8x16_t d1 = vqaddq_u8(vld1q_u8(dst + j + 16), vld1q_u8(src + j + 16));
+        uint8x16_t d2 = vqaddq_u8(vld1q_u8(dst + j + 32), vld1q_u8(src + j + 32));
+        uint8x16_t d3 = vqaddq_u8(vld1q_u8(dst + j + 48), vld1q_u8(src + j + 48));
+
+        vst1q_u8(dst + j, d0);
+        vst1q_u8(dst + j + 16, d1);
+        vst1q_u8(dst + j + 32, d2);
+        vst1q_u8(dst + j + 48, d3);
+    }
+
+    for (; j + 16 <= size; j += 16) {
+        vst1q_u8(dst + j, vqaddq_u8(vld1q_u8(dst + j), vld1q_u8(src + j)));
+    }
+
+    fbg_additiveKernel(dst + j, src + j, size - j);
 }
 
-void fbg_resize(struct _fbg *fbg, int new_width, int new_height) {
-    if (fbg->backend_resize) {
-        fbg->backend_resize(fbg, new_width, new_height);
+static inline uint8x16_t fbg_alphaNEON(uint8x16_t s, uint8x16_t d, uint8x8_t alpha, uint8x8_t ialpha) {
+    uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(s), alpha), vget_low_u8(d), ialpha);
+    uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(s), alpha), vget_high_u8(d), ialpha);
+
+    return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+
+// NEON version of _FBG_MUL255
+static inline uint8x16_t fbg_mul255NEON(uint8x16_t a, uint8x16_t b) {
+    uint16x8_t half = vdupq_n_u16(128);
+
+    uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(a), vget_low_u8(b)), half);
+    uint16x8_t hi = vaddq_u16(vmull_u8(vget_high_u8(a), vget_high_u8(b)), half);
+
+    return vcombine_u8(vshrn_n_u16(vaddq_u16(lo, vshrq_n_u16(lo, 8)), 8), vshrn_n_u16(vaddq_u16(hi, vshrq_n_u16(hi, 8)), 8));
+}
+
+void fbg_alphaKernelNEON(unsigned char *dst, const unsigned char *src, int size, int alpha) {
+    uint8x8_t a = vdup_n_u8(alpha);
+    uint8x8_t ia = vdup_n_u8(255 - alpha);
+
+    int j = 0;
+    for (j = 0; j + 16 <= size; j += 16) {
+        vst1q_u8(dst + j, fbg_alphaNEON(vld1q_u8(src + j), vld1q_u8(dst + j), a, ia));
     }
 
-    if (fbg->allow_resizing) {
-#ifdef FBG_PARALLEL
-        int create_fragments = 0;
-        int parallel_tasks = fbg->parallel_tasks;
+    fbg_alphaKernel(dst + j, src + j, size - j, alpha);
+}
+
+void fbg_maxKernelNEON(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 16 <= size; j += 16) {
+        vst1q_u8(dst + j, vmaxq_u8(vld1q_u8(dst + j), vld1q_u8(src + j)));
+    }
+
+    fbg_maxKernel(dst + j, src + j, size - j);
+}
+
+void fbg_multiplyKernelNEON(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 16 <= size; j += 16) {
+        vst1q_u8(dst + j, fbg_mul255NEON(vld1q_u8(dst + j), vld1q_u8(src + j)));
+    }
+
+    fbg_multiplyKernel(dst + j, src + j, size - j);
+}
+
+void fbg_screenKernelNEON(unsigned char *dst, const unsigned char *src, int size) {
+    int j = 0;
+    for (j = 0; j + 16 <= size; j += 16) {
+        vst1q_u8(dst + j, vmvnq_u8(fbg_mul255NEON(vmvnq_u8(vld1q_u8(dst + j)), vmvnq_u8(vld1q_u8(src + j)))));
+    }
+
+    fbg_screenKernel(dst + j, src + j, size - j);
+}
+
+// copy (alpha < 0) or alpha blend src pixels which does not match the colorkey
+static inline void fbg_colorkeyNEON(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key, int alpha) {
+    uint8x8_t a = vdup_n_u8(alpha < 0 ? 0 : alpha);
+    uint8x8_t ia = vdup_n_u8(alpha < 0 ? 0 : 255 - alpha);
+
+    int j = 0;
+    if (components == 4) {
+        uint32x4_t key_pattern = vdupq_n_u32(key.r | (key.g << 8) | (key.b << 16));
+        uint32x4_t rgb_mask = vdupq_n_u32(0x00ffffff);
+
+        for (j = 0; j + 16 <= size; j += 16) {
+            uint8x16_t d = vld1q_u8(dst + j);
+            uint8x16_t s = vld1q_u8(src + j);
+            uint8x16_t m = vreinterpretq_u8_u32(vceqq_u32(vandq_u32(vreinterpretq_u32_u8(s), rgb_mask), key_pattern));
+
+            if (alpha >= 0) {
+                s = fbg_alphaNEON(s, d, a, ia);
+            }
+
+            vst1q_u8(dst + j, vbslq_u8(m, d, s));
+        }
+    } else if (components == 3) {
+        const uint8_t key_bytes[48] = {
+            key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r,
+            key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g,
+            key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b, key.r, key.g, key.b
+        };
+
+        const uint8_t pixel_start_bytes[48] = {
+            255, 0, 0, 255, 0, 0, 255, 0, 0, 255, 0, 0, 255, 0, 0, 255,
+            0, 0, 255, 0, 0, 255, 0, 0, 255, 0, 0, 255, 0, 0, 255, 0,
+            0, 255, 0, 0, 255, 0, 0, 255, 0, 0, 255, 0, 0, 255, 0, 0
+        };
+
+        uint8x16_t zero = vdupq_n_u8(0);
+
+        for (j = 0; j + 48 <= size; j += 48) {
+            uint8x16_t e0 = vceqq_u8(vld1q_u8(src + j), vld1q_u8(key_bytes));
+            uint8x16_t e1 = vceqq_u8(vld1q_u8(src + j + 16), vld1q_u8(key_bytes + 16));
+            uint8x16_t e2 = vceqq_u8(vld1q_u8(src + j + 32), vld1q_u8(key_bytes + 32));
+
+            // match of the 3 components (first byte of each pixels)
+            uint8x16_t f0 = vandq_u8(vandq_u8(e0, vld1q_u8(pixel_start_bytes)), vandq_u8(vextq_u8(e0, e1, 1), vextq_u8(e0, e1, 2)));
+            uint8x16_t f1 = vandq_u8(vandq_u8(e1, vld1q_u8(pixel_start_bytes + 16)), vandq_u8(vextq_u8(e1, e2, 1), vextq_u8(e1, e2, 2)));
+            uint8x16_t f2 = vandq_u8(vandq_u8(e2, vld1q_u8(pixel_start_bytes + 32)), vandq_u8(vextq_u8(e2, zero, 1), vextq_u8(e2, zero, 2)));
+
+            // spread it over the pixel bytes
+            uint8x16_t m[3];
+            m[0] = vorrq_u8(f0, vorrq_u8(vextq_u8(zero, f0, 15), vextq_u8(zero, f0, 14)));
+            m[1] = vorrq_u8(vorrq_u8(f1, vorrq_u8(vextq_u8(zero, f1, 15), vextq_u8(zero, f1, 14))), vorrq_u8(vextq_u8(f0, zero, 15), vextq_u8(f0, zero, 14)));
+            m[2] = vorrq_u8(vorrq_u8(f2, vorrq_u8(vextq_u8(zero, f2, 15), vextq_u8(zero, f2, 14))), vorrq_u8(vextq_u8(f1, zero, 15), vextq_u8(f1, zero, 14)));
+
+            int k = 0;
+            for (k = 0; k < 3; k += 1) {
+                uint8x16_t d = vld1q_u8(dst + j + k * 16);
+                uint8x16_t s = vld1q_u8(src + j + k * 16);
+
+                if (alpha >= 0) {
+                    s = fbg_alphaNEON(s, d, a, ia);
+                }
+
+                vst1q_u8(dst + j + k * 16, vbslq_u8(m[k], d, s));
+            }
+        }
+    }
+
+    if (alpha >= 0) {
+        fbg_alphaColorkeyKernel(dst + j, src + j, size - j, components, key, alpha);
+    } else {
+        fbg_colorkeyKernel(dst + j, src + j, size - j, components, key);
+    }
+}
+
+void fbg_colorkeyKernelNEON(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key) {
+    fbg_colorkeyNEON(dst, src, size, components, key, -1);
+}
 
-        void *(*user_fragment_start)(struct _fbg *fbg) = NULL;
-        void (*user_fragment)(struct _fbg *fbg, void *user_data) = NULL;
-        void (*user_fragment_stop)(struct _fbg *fbg, void *user_data) = NULL;
+void fbg_alphaColorkeyKernelNEON(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key, int alpha) {
+    fbg_colorkeyNEON(dst, src, size, components, key, alpha);
+}
 #endif
 
-        int new_size = new_width * new_height * fbg->components;
+int fbg_setSIMD(struct _fbg *fbg, int simd) {
+    fbg->simd = simd & fbg_detectSIMD();
+
+    fbg->kernels.additive = fbg_additiveKernel;
+    fbg->kernels.subtract = fbg_subtractKernel;
+    fbg->kernels.alpha = fbg_alphaKernel;
+    fbg->kernels.max = fbg_maxKernel;
+    fbg->kernels.multiply = fbg_multiplyKernel;
+    fbg->kernels.screen = fbg_screenKernel;
+    fbg->kernels.colorkey = fbg_colorkeyKernel;
+    fbg->kernels.alphaColorkey = fbg_alphaColorkeyKernel;
+
+#ifdef FBG_SIMD_X86
+    if (fbg->simd & FBG_SIMD_SSE2) {
+        fbg->kernels.additive = fbg_additiveKernelSSE2;
+        fbg->kernels.subtract = fbg_subtractKernelSSE2;
+        fbg->kernels.alpha = fbg_alphaKernelSSE2;
+        fbg->kernels.max = fbg_maxKernelSSE2;
+        fbg->kernels.multiply = fbg_multiplyKernelSSE2;
+        fbg->kernels.screen = fbg_screenKernelSSE2;
+        fbg->kernels.colorkey = fbg_colorkeyKernelSSE2;
+        fbg->kernels.alphaColorkey = fbg_alphaColorkeyKernelSSE2;
+    }
 
-        if (fbg->initialize_buffers) {
-            unsigned char *back_buffer = calloc(1, new_size * sizeof(char));
-            if (!back_buffer) {
-                fprintf(stderr, "fbg_resize: back_buffer realloc failed!\n");
+    if (fbg->simd & FBG_SIMD_AVX2) {
+        fbg->kernels.additive = fbg_additiveKernelAVX2;
+    }
+#endif
 
-                return;
+#ifdef FBG_SIMD_ARM
+    if (fbg->simd & FBG_SIMD_NEON) {
+        fbg->kernels.additive = fbg_additiveKernelNEON;
+        fbg->kernels.subtract = fbg_subtractKernelNEON;
+        fbg->kernels.alpha = fbg_alphaKernelNEON;
+        fbg->kernels.max = fbg_maxKernelNEON;
+        fbg->kernels.multiply = fbg_multiplyKernelNEON;
+        fbg->kernels.screen = fbg_screenKernelNEON;
+        fbg->kernels.colorkey = fbg_colorkeyKernelNEON;
+        fbg->kernels.alphaColorkey = fbg_alphaColorkeyKernelNEON;
+    }
+#endif
+
+    return fbg->simd;
+}
+
+int fbg_setFormat(struct _fbg *fbg, int format) {
+    int components = (format == FBG_FORMAT_RGBX8888 || format == FBG_FORMAT_BGRX8888) ? 4 : 3;
+
+    if (format < FBG_FORMAT_RGB888 || format > FBG_FORMAT_BGRX8888 || components != fbg->components) {
+        fprintf(stderr, "fbg_setFormat: format %d does not match the context components (%d)!\n", format, fbg->components);
+
+        return 0;
+    }
+
+    fbg->format = format;
+    fbg->bgr = (format == FBG_FORMAT_BGR888 || format == FBG_FORMAT_BGRX8888);
+
+    return 1;
+}
+
+// raster primitives bodies (fbg_rectBody() is in fbgraphics.h) : components is a constant in each of the fbg_*3 / fbg_*4 instances below so that the compiler specialize the loops for it
+
+// blend rows by runs of 64 pixels with the alpha kernel (SIMD), the padding component of 4 components pixels is then set to 0
+static inline void fbg_rectaBody(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a, const int components) {
+    unsigned char color[64 * 4];
+    unsigned char *row_pointer = fbg->back_buffer + y * fbg->line_length + x * components;
+
+    int xx, yy;
+
+    memset(color, 0, sizeof(color));
+
+    for (xx = 0; xx < 64; xx += 1) {
+        color[xx * components] = r;
+        color[xx * components + 1] = g;
+        color[xx * components + 2] = b;
+    }
+
+    for (yy = 0; yy < h; yy += 1) {
+        for (xx = 0; xx < w; xx += 64) {
+            int count = _FBG_MIN(w - xx, 64);
+
+            fbg->kernels.alpha(row_pointer + xx * components, color, count * components, a);
+        }
+
+        if (components == 4) {
+            for (xx = 0; xx < w; xx += 1) {
+                row_pointer[xx * 4 + 3] = 0;
             }
+        }
+
+        row_pointer += fbg->line_length;
+    }
+}
+
+// saturated add / subtract of the amount to rows by runs of 256 bytes with the additive / subtract kernels (SIMD), the padding component of 4 components pixels is faded as well
+static inline void fbg_fadeBody(struct _fbg *fbg, unsigned char amount, int up, const int components) {
+    unsigned char amounts[256];
+
+    int length = fbg->width * components;
+
+    int i, y;
+
+    memset(amounts, amount, sizeof(amounts));
+
+    for (y = 0; y < fbg->height; y += 1) {
+        unsigned char *pix_pointer = fbg->back_buffer + y * fbg->line_length;
+
+        for (i = 0; i < length; i += 256) {
+            int count = _FBG_MIN(length - i, 256);
+
+            if (up) {
+                fbg->kernels.additive(pix_pointer + i, amounts, count);
+            } else {
+                fbg->kernels.subtract(pix_pointer + i, amounts, count);
+            }
+        }
+    }
+}
+
+static inline void fbg_imageColorkeyBody(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int cr, int cg, int cb, const int components) {
+    unsigned char *img_pointer = img->data;
+
+    int i = 0, j = 0;
+
+    for (i = 0; i < img->height; i += 1) {
+        unsigned char *pix_pointer = fbg->back_buffer + (y + i) * fbg->line_length + x * components;
+
+        for (j = 0; j < img->width; j += 1) {
+            if (img_pointer[0] != cr || img_pointer[1] != cg || img_pointer[2] != cb) {
+                memcpy(pix_pointer, img_pointer, components);
+            }
+
+            pix_pointer += components;
+            img_pointer += components;
+        }
+    }
+}
+
+static inline void fbg_imageExBody(struct _fbg *fbg, struct _fbg_img *img, int x, int y, float sx, float sy, int cx, int cy, int cw, int ch, const int components) {
+    float x_ratio_inv = 1.0f / sx;
+    float y_ratio_inv = 1.0f / sy;
+
+    int px, py;
+    int cx2 = (float)cx * sx;
+    int cy2 = (float)cy * sy;
+    int w2 = (float)(cw + cx) * sx;
+    int h2 = (float)(ch + cy) * sy;
+    int i, j;
+
+    int d = w2 - cx2;
+
+    if (d >= (fbg->width - x)) {
+        w2 -= (d - (fbg->width - x));
+    }
+
+    fbg_dirty(fbg, x, y, w2 - cx2, h2 - cy2);
+
+    unsigned char *pix_pointer = fbg->back_buffer + y * fbg->line_length + x * components;
+
+    for (i = cy2; i < h2; i += 1) {
+        py = (int)(x_ratio_inv * (float)i);
+
+        for (j = cx2; j < w2; j += 1) {
+            px = (int)(y_ratio_inv * (float)j);
+
+            memcpy(pix_pointer, img->data + (px + py * img->width) * components, components);
+
+            pix_pointer += components;
+        }
+
+        pix_pointer += fbg->line_length - (w2 - cx2) * components;
+    }
+}
+
+void fbg_rect3(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b) {
+    fbg_rectBody(fbg, x, y, w, h, r, g, b, 3);
+}
+
+void fbg_rect4(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b) {
+    fbg_rectBody(fbg, x, y, w, h, r, g, b, 4);
+}
+
+void fbg_recta3(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    fbg_rectaBody(fbg, x, y, w, h, r, g, b, a, 3);
+}
+
+void fbg_recta4(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    fbg_rectaBody(fbg, x, y, w, h, r, g, b, a, 4);
+}
+
+void fbg_fade3(struct _fbg *fbg, unsigned char amount, int up) {
+    fbg_fadeBody(fbg, amount, up, 3);
+}
+
+void fbg_fade4(struct _fbg *fbg, unsigned char amount, int up) {
+    fbg_fadeBody(fbg, amount, up, 4);
+}
+
+void fbg_imageColorkey3(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int cr, int cg, int cb) {
+    fbg_imageColorkeyBody(fbg, img, x, y, cr, cg, cb, 3);
+}
+
+void fbg_imageColorkey4(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int cr, int cg, int cb) {
+    fbg_imageColorkeyBody(fbg, img, x, y, cr, cg, cb, 4);
+}
+
+void fbg_imageEx3(struct _fbg *fbg, struct _fbg_img *img, int x, int y, float sx, float sy, int cx, int cy, int cw, int ch) {
+    fbg_imageExBody(fbg, img, x, y, sx, sy, cx, cy, cw, ch, 3);
+}
+
+void fbg_imageEx4(struct _fbg *fbg, struct _fbg_img *img, int x, int y, float sx, float sy, int cx, int cy, int cw, int ch) {
+    fbg_imageExBody(fbg, img, x, y, sx, sy, cx, cy, cw, ch, 4);
+}
+
+// select the raster primitives matching the context components count
+void fbg_setupPrimitives(struct _fbg *fbg) {
+    if (fbg->components == 4) {
+        fbg->primitives.rect = fbg_rect4;
+        fbg->primitives.recta = fbg_recta4;
+        fbg->primitives.fade = fbg_fade4;
+        fbg->primitives.imageColorkey = fbg_imageColorkey4;
+        fbg->primitives.imageEx = fbg_imageEx4;
+    } else {
+        fbg->primitives.rect = fbg_rect3;
+        fbg->primitives.recta = fbg_recta3;
+        fbg->primitives.fade = fbg_fade3;
+        fbg->primitives.imageColorkey = fbg_imageColorkey3;
+        fbg->primitives.imageEx = fbg_imageEx3;
+    }
+}
+
+// round size up to a multiple of alignment (power of two)
+#define _FBG_ALIGN_UP(size, alignment) (((size) + (alignment) - 1) & ~((size_t)(alignment) - 1))
+
+// default allocator : FBG_BUFFER_ALIGNMENT aligned heap buffers, anonymous mappings rounded up to FBG_HUGE_PAGE_SIZE with FBG_ALLOC_HUGEPAGES
+void *fbg_defaultAlloc(size_t size, int flags, void *user_data) {
+#ifdef __linux__
+    if (flags & FBG_ALLOC_HUGEPAGES) {
+        size_t length = _FBG_ALIGN_UP(size, FBG_HUGE_PAGE_SIZE);
+
+        void *buffer = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        buffer = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (buffer == MAP_FAILED) {
+            // no huge pages reserved (vm.nr_hugepages), ask for transparent huge pages instead
+            buffer = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (buffer == MAP_FAILED) {
+                fprintf(stderr, "fbg_defaultAlloc: mmap failed!\n");
+
+                return NULL;
+            }
+
+#ifdef MADV_HUGEPAGE
+            madvise(buffer, length, MADV_HUGEPAGE);
+#endif
+        }
+
+        return buffer;
+    }
+#endif
+
+    size_t length = _FBG_ALIGN_UP(size, FBG_BUFFER_ALIGNMENT);
+
+    void *buffer = aligned_alloc(FBG_BUFFER_ALIGNMENT, length);
+    if (!buffer) {
+        fprintf(stderr, "fbg_defaultAlloc: aligned_alloc failed!\n");
+
+        return NULL;
+    }
+
+    memset(buffer, 0, length);
+
+    return buffer;
+}
+
+void fbg_defaultFree(void *buffer, size_t size, int flags, void *user_data) {
+#ifdef __linux__
+    if (flags & FBG_ALLOC_HUGEPAGES) {
+        munmap(buffer, _FBG_ALIGN_UP(size, FBG_HUGE_PAGE_SIZE));
+
+        return;
+    }
+#endif
+
+    free(buffer);
+}
+
+// allocate a buffer with the given allocator / options (options only apply to the context buffers, the allocator may ignore them)
+unsigned char *fbg_allocatorAlloc(struct _fbg_allocator *allocator, int options, size_t size, int usage) {
+    int flags = usage | options;
+
+    unsigned char *buffer = (unsigned char *)allocator->alloc(size, flags, allocator->user_data);
+    if (!buffer) {
+        return NULL;
+    }
+
+#ifdef __linux__
+    if ((flags & FBG_ALLOC_LOCK) && mlock(buffer, size) == -1) {
+        fprintf(stderr, "fbg_allocBuffer: mlock failed, buffer is not locked (RLIMIT_MEMLOCK?)\n");
+    }
+#endif
+
+    return buffer;
+}
+
+void fbg_allocatorFree(struct _fbg_allocator *allocator, int options, unsigned char *buffer, size_t size, int usage) {
+    if (!buffer) {
+        return;
+    }
+
+    int flags = usage | options;
+
+#ifdef __linux__
+    if (flags & FBG_ALLOC_LOCK) {
+        munlock(buffer, size);
+    }
+#endif
+
+    allocator->free(buffer, size, flags, allocator->user_data);
+}
+
+unsigned char *fbg_allocBuffer(struct _fbg *fbg, size_t size, int usage) {
+    return fbg_allocatorAlloc(&fbg->allocator, fbg->alloc_options, size, usage);
+}
+
+void fbg_freeBuffer(struct _fbg *fbg, unsigned char *buffer, size_t size, int usage) {
+    fbg_allocatorFree(&fbg->allocator, fbg->alloc_options, buffer, size, usage);
+}
+
+// rows length in bytes of the back / display buffers for a width
+int fbg_lineLength(struct _fbg *fbg, int width) {
+    int line_length = width * fbg->components;
+
+    if (fbg->row_alignment > 1) {
+        line_length = (int)_FBG_ALIGN_UP(line_length, fbg->row_alignment);
+    }
+
+    return line_length;
+}
+
+// replace the back / display buffers with new size bytes buffers of the context allocator, the current ones (if any) are freed with the given allocator / options
+// fragments are left parked : callers either refuse to run with fragments or reconfigure them afterward (fbg_resize())
+int fbg_replaceDisplayBuffers(struct _fbg *fbg, size_t size, struct _fbg_allocator *old_allocator, int old_options) {
+    unsigned char *back_buffer = fbg_allocBuffer(fbg, size, FBG_ALLOC_FRAME);
+    if (!back_buffer) {
+        fprintf(stderr, "fbg_replaceDisplayBuffers: back_buffer allocation failed!\n");
+
+        return 0;
+    }
+
+    unsigned char *disp_buffer = fbg_allocBuffer(fbg, size, FBG_ALLOC_FRAME);
+    if (!disp_buffer) {
+        fprintf(stderr, "fbg_replaceDisplayBuffers: disp_buffer allocation failed!\n");
+
+        fbg_freeBuffer(fbg, back_buffer, size, FBG_ALLOC_FRAME);
+
+        return 0;
+    }
+
+#ifdef FBG_PARALLEL
+    // fragments (split rendering) may draw into the back buffer
+    fbg_parkFragments(fbg);
+#endif
+
+    unsigned char *old_back_buffer = fbg->back_buffer;
+    unsigned char *old_disp_buffer = fbg->disp_buffer;
+
+    fbg->back_buffer = back_buffer;
+    fbg->disp_buffer = disp_buffer;
+
+    fbg_allocatorFree(old_allocator, old_options, old_back_buffer, fbg->size, FBG_ALLOC_FRAME);
+    fbg_allocatorFree(old_allocator, old_options, old_disp_buffer, fbg->size, FBG_ALLOC_FRAME);
+
+    return 1;
+}
+
+int fbg_allocDisplayBuffers(struct _fbg *fbg) {
+#ifdef FBG_PARALLEL
+    // fragments would stay parked (see fbg_replaceDisplayBuffers())
+    if (fbg->parallel_tasks) {
+        fprintf(stderr, "fbg_allocDisplayBuffers: must be called before fbg_createFragment!\n");
+
+        return 0;
+    }
+#endif
+
+    fbg->back_buffer = NULL;
+    fbg->disp_buffer = NULL;
+
+    if (!fbg_replaceDisplayBuffers(fbg, fbg->size, &fbg->allocator, fbg->alloc_options)) {
+        return 0;
+    }
+
+    fbg->initialize_buffers = 1;
+
+    return 1;
+}
+
+int fbg_setAllocator(struct _fbg *fbg, struct _fbg_allocator *allocator, int options) {
+#ifdef FBG_PARALLEL
+    if (fbg->parallel_tasks) {
+        fprintf(stderr, "fbg_setAllocator: must be called before fbg_createFragment!\n");
+
+        return 0;
+    }
+
+    // pooled buffers were provided by the current allocator
+    pthread_mutex_lock(&fbg->buffer_pool->mutex);
+    fbg_trimBuffers(fbg->buffer_pool, 0);
+    pthread_mutex_unlock(&fbg->buffer_pool->mutex);
+#endif
+
+    struct _fbg_allocator old_allocator = fbg->allocator;
+    int old_options = fbg->alloc_options;
+
+    if (allocator) {
+        fbg->allocator = *allocator;
+    } else {
+        fbg->allocator.alloc = fbg_defaultAlloc;
+        fbg->allocator.free = fbg_defaultFree;
+        fbg->allocator.user_data = NULL;
+    }
+
+    fbg->alloc_options = options;
+
+    if (fbg->initialize_buffers && !fbg_replaceDisplayBuffers(fbg, fbg->size, &old_allocator, old_options)) {
+        fbg->allocator = old_allocator;
+        fbg->alloc_options = old_options;
+
+        return 0;
+    }
+
+#ifdef FBG_PARALLEL
+    // new fragments buffers of all the contexts sharing the pool
+    pthread_mutex_lock(&fbg->buffer_pool->mutex);
+    fbg->buffer_pool->allocator = fbg->allocator;
+    fbg->buffer_pool->alloc_options = fbg->alloc_options;
+    pthread_mutex_unlock(&fbg->buffer_pool->mutex);
+#endif
+
+    return 1;
+}
+
+int fbg_setRowAlignment(struct _fbg *fbg, int alignment) {
+    if (!fbg->initialize_buffers) {
+        fprintf(stderr, "fbg_setRowAlignment: the context does not own its buffers!\n");
+
+        return 0;
+    }
+
+    if (alignment < 0 || (alignment & (alignment - 1))) {
+        fprintf(stderr, "fbg_setRowAlignment: alignment must be a power of two!\n");
+
+        return 0;
+    }
+
+#ifdef FBG_PARALLEL
+    if (fbg->parallel_tasks) {
+        fprintf(stderr, "fbg_setRowAlignment: must be called before fbg_createFragment!\n");
+
+        return 0;
+    }
+#endif
+
+    int old_alignment = fbg->row_alignment;
+
+    fbg->row_alignment = alignment;
+
+    int line_length = fbg_lineLength(fbg, fbg->width);
+
+    if (!fbg_replaceDisplayBuffers(fbg, (size_t)line_length * fbg->height, &fbg->allocator, fbg->alloc_options)) {
+        fbg->row_alignment = old_alignment;
+
+        return 0;
+    }
+
+    fbg->line_length = line_length;
+
+    fbg->size = line_length * fbg->height;
+
+    return 1;
+}
+
+struct _fbg *fbg_customSetup(
+        int width, int height,
+        int components,
+        int initialize_buffers,
+        int allow_resizing,
+        void *user_context,
+        void (*user_draw)(struct _fbg *fbg),
+        void (*user_flip)(struct _fbg *fbg),
+        void (*backend_resize)(struct _fbg *fbg, unsigned int new_width, unsigned int new_height),
+        void (*user_free)(struct _fbg *fbg)) {
+    struct _fbg *fbg = (struct _fbg *)calloc(1, sizeof(struct _fbg));
+    if (!fbg) {
+        fprintf(stderr, "fbg_customSetup: fbg calloc failed!\n");
+
+        return NULL;
+    }
+
+    fbg->user_flip = user_flip;
+    fbg->user_draw = user_draw;
+    fbg->user_free = user_free;
+    fbg->backend_resize = backend_resize;
+
+    fbg->width = width;
+    fbg->height = height;
+
+    fbg->components = components;
+    fbg->comp_offset = components - 3;
+
+    fbg->format = (components == 4) ? FBG_FORMAT_RGBX8888 : FBG_FORMAT_RGB888;
+
+    fbg->line_length = fbg->width * fbg->components;
+
+    fbg->width_n_height = fbg->width * fbg->height;
+
+    fbg->size = fbg->width * fbg->height * fbg->components;
+
+    fbg->region.row_step = 1;
+    fbg->region.display_width = fbg->width;
+    fbg->region.display_height = fbg->height;
+
+    fbg->user_context = user_context;
+
+    fbg->allocator.alloc = fbg_defaultAlloc;
+    fbg->allocator.free = fbg_defaultFree;
+
+    if (initialize_buffers) {
+        if (!fbg_allocDisplayBuffers(fbg)) {
+            fprintf(stderr, "fbg_customSetup: buffers allocation failed!\n");
+
+            user_free(fbg);
+
+            free(fbg);
+
+            return NULL;
+        }
+    }
+
+    fbg->initialize_buffers = initialize_buffers;
+
+    gettimeofday(&fbg->fps_start, NULL);
+
+    fbg_textColor(fbg, 255, 255, 255);
+
+    fbg->allow_resizing = allow_resizing;
+
+    fbg_setSIMD(fbg, fbg_detectSIMD());
+    fbg_setupPrimitives(fbg);
+
+#ifdef FBG_PARALLEL
+    fbg->state = 1;
+    fbg->frame = 0;
+    fbg->fps = 0;
+
+    fbg->tasks = 0;
+
+#ifdef FBG_LFDS
+    fbg->fragment_queue_size = 7;
+#else
+    fbg->fragment_queue_size = 2;
+#endif
+
+    fbg->wait_spin = 100;
+
+    fbg->draw_policy = FBG_DRAW_QUEUE;
+
+    fbg->reserved_cpu = -1;
+
+    fbg->pool = (struct _fbg_pool *)calloc(1, sizeof(struct _fbg_pool));
+    if (!fbg->pool) {
+        fprintf(stderr, "fbg_customSetup: pool calloc failed!\n");
+
+        if (user_free) {
+            user_free(fbg);
+        }
+
+        if (initialize_buffers) {
+            fbg_freeBuffer(fbg, fbg->back_buffer, fbg->size, FBG_ALLOC_FRAME);
+            fbg_freeBuffer(fbg, fbg->disp_buffer, fbg->size, FBG_ALLOC_FRAME);
+        }
+
+        free(fbg);
+
+        return NULL;
+    }
+
+    atomic_store(&fbg->pool->references, 1);
+    atomic_store(&fbg->pool->wait_spin, fbg->wait_spin);
+
+    fbg->buffer_pool = (struct _fbg_buffer_pool *)calloc(1, sizeof(struct _fbg_buffer_pool));
+    if (!fbg->buffer_pool) {
+        fprintf(stderr, "fbg_customSetup: buffer_pool calloc failed!\n");
+
+        if (user_free) {
+            user_free(fbg);
+        }
+
+        if (initialize_buffers) {
+            fbg_freeBuffer(fbg, fbg->back_buffer, fbg->size, FBG_ALLOC_FRAME);
+            fbg_freeBuffer(fbg, fbg->disp_buffer, fbg->size, FBG_ALLOC_FRAME);
+        }
+
+        free(fbg->pool);
+        free(fbg);
+
+        return NULL;
+    }
+
+    fbg->buffer_pool->allocator = fbg->allocator;
+    fbg->buffer_pool->alloc_options = fbg->alloc_options;
+
+    atomic_store(&fbg->buffer_pool->references, 1);
+    pthread_mutex_init(&fbg->buffer_pool->mutex, NULL);
+#endif
+
+    fbg->new_width = 0;
+    fbg->new_height = 0;
+
+    return fbg;
+}
+
+void fbg_setResizeCallback(struct _fbg *fbg, void (*user_resize)(struct _fbg *fbg, unsigned int new_width, unsigned int new_height)) {
+    fbg->user_resize = user_resize;
+}
+
+void fbg_resize(struct _fbg *fbg, int new_width, int new_height) {
+    if (fbg->backend_resize) {
+        fbg->backend_resize(fbg, new_width, new_height);
+    }
+
+    if (fbg->allow_resizing) {
+
+        int line_length = fbg_lineLength(fbg, new_width);
+
+        int new_size = line_length * new_height;
+
+        if (fbg->initialize_buffers) {
+            if (!fbg_replaceDisplayBuffers(fbg, new_size, &fbg->allocator, fbg->alloc_options)) {
+                fprintf(stderr, "fbg_resize: buffers allocation failed!\n");
+
+                return;
+            }
+        }
+
+        fbg->width = new_width;
+        fbg->height = new_height;
+
+        fbg->line_length = line_length;
+
+        fbg->width_n_height = fbg->width * fbg->height;
+
+        fbg->size = new_size;
+
+        fbg->region.display_width = fbg->width;
+        fbg->region.display_height = fbg->height;
+
+        // tiles hashes are computed again for the new size
+        fbg->idle.hashed = 0;
+
+        if (fbg->dirty_tiles) {
+            free(fbg->dirty_tiles);
+
+            fbg->dirty_tiles = fbg_allocTiles(fbg->width, fbg->height);
+        }
+
+        if (fbg->user_resize) {
+            fbg->user_resize(fbg, new_width, new_height);
+        }
+
+#ifdef FBG_PARALLEL
+        // resize fragments contexts and buffers, threads and user data are kept
+        if (fbg->tasks) {
+            struct _fbg_fragment *frag = fbg->fragments[0];
+
+            fbg_updateFragments(fbg, frag->user_fragment_start, frag->user_fragment, frag->user_fragment_stop, fbg->parallel_tasks, 0);
+        }
+#endif
+    } else {
+        if (fbg->user_resize) {
+            fbg->user_resize(fbg, new_width, new_height);
+        }
+    }
+}
+
+void fbg_pushResize(struct _fbg *fbg, int new_width, int new_height) {
+    if (new_width > 0 && new_height > 0) {
+        fbg->new_width = new_width;
+        fbg->new_height = new_height;
+    }
+}
+
+#ifdef FBG_PARALLEL
+// tell a thread/fragment that it should stop (also when parked)
+void fbg_terminateFragment(struct _fbg_fragment *frag) {
+    frag->state = FBG_FRAGMENT_STOPPED;
+
+    fbg_wakeFragment(frag);
+
+    fbg_setSync(&frag->parked, 0);
+}
+
+// basically tell all threads/fragments that they should stop
+void fbg_terminateFragments(struct _fbg *fbg) {
+    int i = 0;
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        fbg_terminateFragment(fbg->fragments[i]);
+    }
+
+    if (fbg->sync_barrier) {
+        fbg_wakeSync(&fbg->sync_barrier->generation);
+    }
+}
+
+// wait for a terminated thread/fragment and free it
+void fbg_freeFragment(pthread_t task, struct _fbg_fragment *frag) {
+    if (frag->pooled) {
+        // no thread, its frames jobs are completed
+        if (frag->started && frag->started_stop) {
+            frag->started_stop(frag->fbg, frag->user_data);
+        }
+    } else {
+        pthread_join(task, NULL);
+    }
+
+    fbg_freeFragmentBuffers(frag);
+
+    free(frag->fbg);
+
+    free(frag);
+}
+
+void fbg_freeTasks(struct _fbg *fbg) {
+    // pooled fragments frame still running
+    fbg_waitTaskGroup(fbg, &fbg->fragments_group);
+
+    int i = 0;
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        fbg_freeFragment(fbg->tasks[i], fbg->fragments[i]);
+    }
+
+    free(fbg->sync_barrier);
+
+    fbg->sync_barrier = NULL;
+
+    free(fbg->tasks);
+    free(fbg->fragments);
+
+    fbg->tasks = NULL;
+    fbg->fragments = NULL;
+
+    fbg->parallel_tasks = 0;
+}
+#endif
+
+void fbg_close(struct _fbg *fbg) {
+#ifdef FBG_PARALLEL
+    fbg_terminateFragments(fbg);
+
+    fbg_freeTasks(fbg);
+#endif
+
+    if (fbg->user_free) {
+        fbg->user_free(fbg);
+    }
+
+    if (fbg->initialize_buffers) {
+        fbg_freeBuffer(fbg, fbg->back_buffer, fbg->size, FBG_ALLOC_FRAME);
+        fbg_freeBuffer(fbg, fbg->disp_buffer, fbg->size, FBG_ALLOC_FRAME);
+    }
+
+    free(fbg->idle.tiles_hash);
+    free(fbg->dirty_tiles);
+
+#ifdef FBG_PARALLEL
+    free(fbg->mixing);
+    free(fbg->thread_settings);
+
+    fbg_releasePool(fbg->pool);
+
+    fbg_releaseBufferPool(fbg->buffer_pool);
+#endif
+
+    free(fbg);
+}
+
+void fbg_computeFramerate(struct _fbg *fbg, int to_string) {
+    gettimeofday(&fbg->fps_stop, NULL);
+
+    double ms = (fbg->fps_stop.tv_sec - fbg->fps_start.tv_sec) * 1000000.0 - (fbg->fps_stop.tv_usec - fbg->fps_start.tv_usec);
+    if (ms >= 1000.0) {
+        gettimeofday(&fbg->fps_start, NULL);
+
+#ifdef FBG_PARALLEL
+        atomic_exchange_explicit(&fbg->fps, fbg->frame, memory_order_relaxed);
+#else
+        fbg->fps = fbg->frame;
+#endif
+        fbg->frame = 0;
+
+        if (to_string) {
+            sprintf(fbg->fps_char, "%lu", (long unsigned int)fbg->fps);
+        }
+    }
+
+    fbg->frame += 1;
+}
+
+
+void fbg_drawFramerate(struct _fbg *fbg, struct _fbg_font *fnt, int task, int x, int y, int r, int g, int b) {
+#ifdef FBG_PARALLEL
+    if (task > fbg->parallel_tasks) {
+        return;
+    }
+#endif
+
+    if (!fnt) {
+        fnt = &fbg->current_font;
+    }
+
+#ifdef FBG_PARALLEL
+    if (task > 0) {
+        task -= 1;
+
+        static char fps_char[10];
+
+        atomic_uint_fast16_t fps = atomic_load_explicit(&fbg->fragments[task]->fbg->fps, memory_order_relaxed);
+
+        sprintf(fps_char, "%i", (int)fps);
+
+        fbg_text(fbg, fnt, fps_char, x, y, r, g, b);
+
+        return;
+    }
+#endif
+
+    fbg_text(fbg, fnt, fbg->fps_char, x, y, r, g, b);
+}
+
+int fbg_getFramerate(struct _fbg *fbg, int task) {
+#ifdef FBG_PARALLEL
+    if (task > fbg->parallel_tasks) {
+        return -1;
+    }
+
+    if (task > 0) {
+        task -= 1;
+
+        atomic_uint_fast16_t fps = atomic_load_explicit(&fbg->fragments[task]->fbg->fps, memory_order_relaxed);
+
+        return (int)fps;
+    }
+#endif
+
+    return fbg->fps;
+}
+
+uint64_t fbg_timeNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+#ifdef FBG_PARALLEL
+
+// spin-wait hint, let the core save power / the sibling hyper-thread run
+void fbg_cpuRelax() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__arm__))
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// sleep until the value change (or a wake up / timeout)
+void fbg_sleepSync(struct _fbg_sync *sync, int expected) {
+#ifdef __linux__
+    // timeout is a safety net for wake ups which does not change the value (termination, parallel jobs)
+    struct timespec timeout = { 0, 10000000 };
+
+    syscall(SYS_futex, &sync->value, FUTEX_WAIT_PRIVATE, expected, &timeout, NULL, 0);
+#else
+    struct timespec duration = { 0, 50000 };
+
+    nanosleep(&duration, NULL);
+#endif
+}
+
+// wake threads sleeping on the value
+void fbg_wakeSync(struct _fbg_sync *sync) {
+#ifdef __linux__
+    if (atomic_load(&sync->sleepers) > 0) {
+        syscall(SYS_futex, &sync->value, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+#endif
+}
+
+// set the value and wake the threads waiting on it
+void fbg_setSync(struct _fbg_sync *sync, int value) {
+    atomic_store(&sync->value, value);
+
+    fbg_wakeSync(sync);
+}
+
+// wait while the value is equal to expected (and state is FBG_FRAGMENT_RUNNING) : spin for spin_time microseconds (-1 = forever) then sleep
+// help with the pool jobs while waiting if not NULL, waiting time / sleeps are added to wait_time / wait_sleeps if not NULL
+void fbg_waitSync(struct _fbg_sync *sync, int expected, atomic_int *state, int spin_time, struct _fbg_pool *pool, atomic_uint_fast64_t *wait_time, atomic_uint_fast64_t *wait_sleeps) {
+    if (atomic_load(&sync->value) != expected || atomic_load(state) != FBG_FRAGMENT_RUNNING) {
+        return;
+    }
+
+    uint64_t start = fbg_timeNs();
+    uint64_t spin_end = start + (uint64_t)_FBG_MAX(spin_time, 0) * 1000ull;
+
+    int spins = 0;
+    while (atomic_load(&sync->value) == expected && atomic_load(state) == FBG_FRAGMENT_RUNNING) {
+        if (pool) {
+            fbg_helpJobs(pool);
+        }
+
+        if (spin_time < 0 || ((spins++ & 63) != 0) || fbg_timeNs() < spin_end) {
+            fbg_cpuRelax();
+
+            continue;
+        }
+
+        // registered before the last check so that fbg_setSync can't miss us
+        atomic_fetch_add(&sync->sleepers, 1);
+
+        if (atomic_load(&sync->value) == expected && atomic_load(state) == FBG_FRAGMENT_RUNNING) {
+            fbg_sleepSync(sync, expected);
+
+            if (wait_sleeps) {
+                atomic_fetch_add_explicit(wait_sleeps, 1, memory_order_relaxed);
+            }
+        }
+
+        atomic_fetch_sub(&sync->sleepers, 1);
+    }
+
+    if (wait_time) {
+        atomic_fetch_add_explicit(wait_time, fbg_timeNs() - start, memory_order_relaxed);
+    }
+}
+
+// wait till all fragments reached the barrier (or the fragment is terminated)
+void fbg_barrierWait(struct _fbg_barrier *barrier, struct _fbg_fragment *fragment) {
+    int generation = atomic_load(&barrier->generation.value);
+
+    if (atomic_fetch_add(&barrier->arrived, 1) == barrier->count - 1) {
+        atomic_store(&barrier->arrived, 0);
+
+        fbg_setSync(&barrier->generation, generation + 1);
+
+        return;
+    }
+
+    fbg_waitSync(&barrier->generation, generation, &fragment->state, fragment->fbg->wait_spin, fragment->pool, NULL, NULL);
+}
+
+// process job work items until there is none left to claim, return the number of processed items
+int fbg_workJob(struct _fbg_pool *pool, struct _fbg_job *job) {
+    int index = 0, processed = 0;
+    while ((index = atomic_fetch_add(&job->next, 1)) < job->count) {
+        job->fn(job, index);
+
+        processed += 1;
+
+        if (atomic_fetch_add(&job->done, 1) == job->count - 1) {
+            // last work item : release the job slot (it is reused once all helpers left) and signal the group
+            struct _fbg_task_group *group = job->group;
+
+            atomic_store(&job->active, 0);
+            atomic_store(&job->used, 0);
+
+            atomic_fetch_sub(&group->pending, 1);
+
+            atomic_fetch_add(&pool->completed.value, 1);
+            fbg_wakeSync(&pool->completed);
+        }
+    }
+
+    return processed;
+}
+
+// called by idle threads, help with the pending jobs if any, return the number of processed work items
+// the first slot looked at rotate so that threads spread over the jobs of all contexts sharing the pool
+int fbg_helpJobs(struct _fbg_pool *pool) {
+    unsigned int first_job = atomic_fetch_add_explicit(&pool->next_job, 1, memory_order_relaxed);
+
+    int i = 0, processed = 0;
+    for (i = 0; i < FBG_MAX_JOBS; i += 1) {
+        struct _fbg_job *job = &pool->jobs[(first_job + i) % FBG_MAX_JOBS];
+
+        if (!atomic_load(&job->active)) {
+            continue;
+        }
+
+        // register first so that the slot can't be reused while we are inside
+        atomic_fetch_add(&job->helpers, 1);
+
+        if (atomic_load(&job->active)) {
+            processed += fbg_workJob(pool, job);
+        }
+
+        atomic_fetch_sub(&job->helpers, 1);
+    }
+
+    return processed;
+}
+
+// submit a job (fn, data, count and range fields of desc) to the pool, it is run on the calling thread when all slots are taken
+void fbg_submitJob(struct _fbg *fbg, struct _fbg_task_group *group, struct _fbg_job *desc) {
+    struct _fbg_pool *pool = fbg->pool;
+
+    if (desc->count <= 0) {
+        return;
+    }
+
+    int i = 0;
+    struct _fbg_job *job = NULL;
+    for (i = 0; i < FBG_MAX_JOBS; i += 1) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&pool->jobs[i].used, &expected, 1)) {
+            job = &pool->jobs[i];
+
+            break;
+        }
+    }
+
+    if (!job) {
+        for (i = 0; i < desc->count; i += 1) {
+            desc->fn(desc, i);
+        }
+
+        return;
+    }
+
+    // wait for late helpers of the previous job
+    while (atomic_load(&job->helpers)) {
+        fbg_cpuRelax();
+    }
+
+    job->fn = desc->fn;
+    job->data = desc->data;
+    job->count = desc->count;
+    job->fbg = desc->fbg;
+    job->range_fn = desc->range_fn;
+    job->begin = desc->begin;
+    job->end = desc->end;
+    job->grain = desc->grain;
+    job->group = group;
+
+    atomic_fetch_add(&group->pending, 1);
+
+    atomic_store(&job->next, 0);
+    atomic_store(&job->done, 0);
+    atomic_store(&job->active, 1);
+
+    // wake workers and fragments threads sleeping while waiting for their buffer to be consumed
+    atomic_fetch_add(&pool->submitted.value, 1);
+    fbg_wakeSync(&pool->submitted);
+
+    for (i = 0; i < fbg->parallel_tasks && fbg->fragments; i += 1) {
+        fbg_wakeFragment(fbg->fragments[i]);
+    }
+}
+
+void fbg_initTaskGroup(struct _fbg_task_group *group) {
+    atomic_store(&group->pending, 0);
+}
+
+void fbg_waitTaskGroup(struct _fbg *fbg, struct _fbg_task_group *group) {
+    struct _fbg_pool *pool = fbg->pool;
+
+    atomic_int running = FBG_FRAGMENT_RUNNING;
+
+    while (1) {
+        int completed = atomic_load(&pool->completed.value);
+
+        if (atomic_load(&group->pending) == 0) {
+            break;
+        }
+
+        // all work items are claimed : wait for the last ones to complete
+        if (!fbg_helpJobs(pool)) {
+            fbg_waitSync(&pool->completed, completed, &running, fbg->wait_spin, pool, NULL, NULL);
+        }
+    }
+}
+
+// run a job on the calling thread, the workers threads and any idle fragments threads, return when all work items are completed
+void fbg_runJob(struct _fbg *fbg, void (*fn)(struct _fbg_job *job, int index), void *data, int count) {
+    struct _fbg_task_group group;
+    fbg_initTaskGroup(&group);
+
+    struct _fbg_job desc;
+    memset(&desc, 0, sizeof(struct _fbg_job));
+    desc.fn = fn;
+    desc.data = data;
+    desc.count = count;
+
+    fbg_submitJob(fbg, &group, &desc);
+
+    fbg_waitTaskGroup(fbg, &group);
+}
+
+// work item of a range job
+void fbg_rangeJob(struct _fbg_job *job, int index) {
+    int begin = job->begin + index * job->grain;
+
+    job->range_fn(job->fbg, begin, _FBG_MIN(begin + job->grain, job->end), job->data);
+}
+
+void fbg_parallelForAsync(struct _fbg *fbg, struct _fbg_task_group *group, int begin, int end, int grain, void (*fn)(struct _fbg *fbg, int begin, int end, void *user_data), void *user_data) {
+    if (end <= begin) {
+        return;
+    }
+
+    if (grain <= 0) {
+        // a few work items per thread so that threads which joined late still get some
+        int threads = 1 + fbg->pool->workers_count + (fbg->fragments_pooled ? 0 : fbg->parallel_tasks);
+
+        grain = _FBG_MAX((end - begin) / (threads * 4), 1);
+    }
+
+    struct _fbg_job desc;
+    memset(&desc, 0, sizeof(struct _fbg_job));
+    desc.fn = fbg_rangeJob;
+    desc.data = user_data;
+    desc.count = (end - begin + grain - 1) / grain;
+    desc.fbg = fbg;
+    desc.range_fn = fn;
+    desc.begin = begin;
+    desc.end = end;
+    desc.grain = grain;
+
+    fbg_submitJob(fbg, group, &desc);
+}
+
+void fbg_parallelFor(struct _fbg *fbg, int begin, int end, int grain, void (*fn)(struct _fbg *fbg, int begin, int end, void *user_data), void *user_data) {
+    struct _fbg_task_group group;
+    fbg_initTaskGroup(&group);
+
+    fbg_parallelForAsync(fbg, &group, begin, end, grain, fn, user_data);
+
+    fbg_waitTaskGroup(fbg, &group);
+}
+
+// workers threads loop : work on jobs, sleep while there is none
+void fbg_worker(struct _fbg_pool *pool) {
+    while (atomic_load(&pool->state) == FBG_FRAGMENT_RUNNING) {
+        int submitted = atomic_load(&pool->submitted.value);
+
+        if (!fbg_helpJobs(pool)) {
+            fbg_waitSync(&pool->submitted, submitted, &pool->state, pool->wait_spin, NULL, NULL, NULL);
+        }
+    }
+}
+
+// terminate the pool workers threads
+void fbg_stopWorkers(struct _fbg_pool *pool) {
+    int i = 0;
+    if (pool->workers_count > 0) {
+        atomic_store(&pool->state, FBG_FRAGMENT_STOPPED);
+
+        fbg_wakeSync(&pool->submitted);
+
+        for (i = 0; i < pool->workers_count; i += 1) {
+            pthread_join(pool->workers[i], NULL);
+        }
+    }
+
+    free(pool->workers);
+
+    pool->workers = NULL;
+    pool->workers_count = 0;
+}
+
+void fbg_createWorkers(struct _fbg *fbg, unsigned int count) {
+    struct _fbg_pool *pool = fbg->pool;
+
+    fbg_stopWorkers(pool);
+
+    if (count == 0) {
+        return;
+    }
+
+    pool->workers = (pthread_t *)malloc(sizeof(pthread_t) * count);
+    if (!pool->workers) {
+        fprintf(stderr, "fbg_createWorkers: workers malloc failed!\n");
+
+        return;
+    }
+
+    atomic_store(&pool->state, FBG_FRAGMENT_RUNNING);
+
+    pthread_attr_t attr;
+    fbg_initThreadAttr(fbg, &attr, 0);
+
+    int i = 0;
+    for (i = 0; i < (int)count; i += 1) {
+        int err = pthread_create(&pool->workers[i], &attr, (void * (*)(void *))fbg_worker, pool);
+        if (err) {
+            fprintf(stderr, "fbg_createWorkers: pthread_create error '%i'!\n", err);
+
+            break;
+        }
+
+        // workers take the CPUs after the fragments ones with FBG_CPU_AUTO
+        fbg_applyThreadSettings(fbg, pool->workers[i], 0, (fbg->fragments_pooled ? 0 : fbg->parallel_tasks) + i);
+
+        pool->workers_count += 1;
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+// drop a context reference to a pool, the pool and its workers are freed with the last one
+void fbg_releasePool(struct _fbg_pool *pool) {
+    if (atomic_fetch_sub(&pool->references, 1) > 1) {
+        return;
+    }
+
+    fbg_stopWorkers(pool);
+
+    free(pool);
+}
+
+void fbg_sharePool(struct _fbg *fbg, struct _fbg *pool_fbg) {
+    if (fbg->pool == pool_fbg->pool) {
+        return;
+    }
+
+    if (fbg->parallel_tasks > 0 || fbg->pool->workers_count > 0) {
+        fprintf(stderr, "fbg_sharePool: the context already has fragments or workers!\n");
+
+        return;
+    }
+
+    fbg_releasePool(fbg->pool);
+
+    fbg->pool = pool_fbg->pool;
+
+    atomic_fetch_add(&fbg->pool->references, 1);
+
+    fbg->pool->shared = 1;
+
+    // fragments buffers of all the contexts are capped together
+    if (fbg->buffer_pool != pool_fbg->buffer_pool) {
+        fbg_releaseBufferPool(fbg->buffer_pool);
+
+        fbg->buffer_pool = pool_fbg->buffer_pool;
+
+        atomic_fetch_add(&fbg->buffer_pool->references, 1);
+    }
+}
+
+atomic_int fbg_fragmentState(struct _fbg_fragment *fbg_fragment) {
+    return fbg_fragment->state;
+}
+
+// wake threads waiting on any of the fragment buffers
+void fbg_wakeFragment(struct _fbg_fragment *fragment) {
+    int i = 0;
+    for (i = 0; i < fragment->buffers_count; i += 1) {
+        fbg_wakeSync(&fragment->sync_wait[i]);
+    }
+
+#ifdef FBG_LFDS
+    if (fragment->ringbuffer) {
+        fbg_wakeSync(&fragment->ringbuffer->freed);
+    }
+#endif
+}
+
+// size class of a buffer : sizes are rounded up to 1/8 of their power of two (4096 bytes at least) so that close sizes share buffers
+size_t fbg_bufferClass(size_t size) {
+    size_t step = 4096;
+    while (step * 8 < size) {
+        step *= 2;
+    }
+
+    return (size + step - 1) / step * step;
+}
+
+// free unused buffers of the pool till at least needed bytes can be allocated within the limit (all of them when needed is 0), the pool mutex must be held
+void fbg_trimBuffers(struct _fbg_buffer_pool *buffer_pool, size_t needed) {
+    int i = 0;
+    for (i = buffer_pool->count - 1; i >= 0; i -= 1) {
+        if (needed && (!buffer_pool->limit || buffer_pool->allocated + needed <= buffer_pool->limit)) {
+            return;
+        }
+
+        struct _fbg_pooled_buffer *pooled_buffer = &buffer_pool->buffers[i];
+        if (pooled_buffer->used) {
+            continue;
+        }
+
+        fbg_allocatorFree(&pooled_buffer->allocator, pooled_buffer->alloc_options, pooled_buffer->buffer, pooled_buffer->size, FBG_ALLOC_FRAGMENT);
+
+        buffer_pool->allocated -= pooled_buffer->size;
+
+        buffer_pool->count -= 1;
+        buffer_pool->buffers[i] = buffer_pool->buffers[buffer_pool->count];
+    }
+}
+
+// borrow a cleared buffer of at least size bytes from the pool, NULL when the pool limit is reached (unless forced)
+unsigned char *fbg_borrowBuffer(struct _fbg_buffer_pool *buffer_pool, size_t size, int force) {
+    size_t class_size = fbg_bufferClass(size);
+
+    pthread_mutex_lock(&buffer_pool->mutex);
+
+    int i = 0;
+    for (i = 0; i < buffer_pool->count; i += 1) {
+        struct _fbg_pooled_buffer *pooled_buffer = &buffer_pool->buffers[i];
+
+        // buffers of a previous allocator are not reused (see fbg_setAllocator())
+        if (!pooled_buffer->used && pooled_buffer->size == class_size &&
+            pooled_buffer->allocator.alloc == buffer_pool->allocator.alloc &&
+            pooled_buffer->allocator.user_data == buffer_pool->allocator.user_data &&
+            pooled_buffer->alloc_options == buffer_pool->alloc_options) {
+            pooled_buffer->used = 1;
+
+            buffer_pool->used += class_size;
+
+            pthread_mutex_unlock(&buffer_pool->mutex);
+
+            memset(pooled_buffer->buffer, 0, size);
+
+            return pooled_buffer->buffer;
+        }
+    }
+
+    fbg_trimBuffers(buffer_pool, class_size);
+
+    if (buffer_pool->limit && buffer_pool->allocated + class_size > buffer_pool->limit && !force) {
+        pthread_mutex_unlock(&buffer_pool->mutex);
+
+        return NULL;
+    }
+
+    if (buffer_pool->count == buffer_pool->capacity) {
+        int capacity = _FBG_MAX(buffer_pool->capacity * 2, 8);
+
+        struct _fbg_pooled_buffer *buffers = (struct _fbg_pooled_buffer *)realloc(buffer_pool->buffers, sizeof(struct _fbg_pooled_buffer) * capacity);
+        if (!buffers) {
+            fprintf(stderr, "fbg_borrowBuffer: buffers realloc failed!\n");
+
+            pthread_mutex_unlock(&buffer_pool->mutex);
+
+            return NULL;
+        }
+
+        buffer_pool->buffers = buffers;
+        buffer_pool->capacity = capacity;
+    }
+
+    unsigned char *buffer = fbg_allocatorAlloc(&buffer_pool->allocator, buffer_pool->alloc_options, class_size, FBG_ALLOC_FRAGMENT);
+    if (!buffer) {
+        fprintf(stderr, "fbg_borrowBuffer: buffer allocation failed!\n");
+
+        pthread_mutex_unlock(&buffer_pool->mutex);
+
+        return NULL;
+    }
+
+    struct _fbg_pooled_buffer *pooled_buffer = &buffer_pool->buffers[buffer_pool->count];
+    pooled_buffer->buffer = buffer;
+    pooled_buffer->size = class_size;
+    pooled_buffer->used = 1;
+    pooled_buffer->allocator = buffer_pool->allocator;
+    pooled_buffer->alloc_options = buffer_pool->alloc_options;
+
+    buffer_pool->count += 1;
+    buffer_pool->allocated += class_size;
+    buffer_pool->used += class_size;
+    buffer_pool->peak = _FBG_MAX(buffer_pool->peak, buffer_pool->allocated);
+
+    pthread_mutex_unlock(&buffer_pool->mutex);
+
+    return buffer;
+}
+
+// give a borrowed buffer back to the pool, it is kept for later use
+void fbg_returnBuffer(struct _fbg_buffer_pool *buffer_pool, unsigned char *buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    pthread_mutex_lock(&buffer_pool->mutex);
+
+    int i = 0;
+    for (i = 0; i < buffer_pool->count; i += 1) {
+        struct _fbg_pooled_buffer *pooled_buffer = &buffer_pool->buffers[i];
+
+        if (pooled_buffer->buffer == buffer) {
+            pooled_buffer->used = 0;
+
+            buffer_pool->used -= pooled_buffer->size;
+
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&buffer_pool->mutex);
+}
+
+// release a context reference to a buffer pool, the pool and its buffers are freed with the last one
+void fbg_releaseBufferPool(struct _fbg_buffer_pool *buffer_pool) {
+    if (atomic_fetch_sub(&buffer_pool->references, 1) > 1) {
+        return;
+    }
+
+    fbg_trimBuffers(buffer_pool, 0);
+
+    pthread_mutex_destroy(&buffer_pool->mutex);
+
+    free(buffer_pool->buffers);
+    free(buffer_pool);
+}
+
+void fbg_setBufferPoolLimit(struct _fbg *fbg, size_t limit) {
+    pthread_mutex_lock(&fbg->buffer_pool->mutex);
+
+    fbg->buffer_pool->limit = limit;
+
+    fbg_trimBuffers(fbg->buffer_pool, 1);
+
+    pthread_mutex_unlock(&fbg->buffer_pool->mutex);
+}
+
+void fbg_trimBufferPool(struct _fbg *fbg) {
+    pthread_mutex_lock(&fbg->buffer_pool->mutex);
+    fbg_trimBuffers(fbg->buffer_pool, 0);
+    pthread_mutex_unlock(&fbg->buffer_pool->mutex);
+}
+
+void fbg_getBufferPoolStats(struct _fbg *fbg, struct _fbg_buffer_pool_stats *stats) {
+    struct _fbg_buffer_pool *buffer_pool = fbg->buffer_pool;
+
+    pthread_mutex_lock(&buffer_pool->mutex);
+
+    stats->allocated = buffer_pool->allocated;
+    stats->used = buffer_pool->used;
+    stats->peak = buffer_pool->peak;
+    stats->limit = buffer_pool->limit;
+    stats->buffers = buffer_pool->count;
+
+    stats->free_buffers = 0;
+
+    int i = 0;
+    for (i = 0; i < buffer_pool->count; i += 1) {
+        stats->free_buffers += !buffer_pool->buffers[i].used;
+    }
+
+    pthread_mutex_unlock(&buffer_pool->mutex);
+}
+
+// allocate fragment buffers (a single shared back buffer area in split rendering mode), buffers are borrowed from the buffer pool, there may be less than count of them when the pool limit is reached (min_count are always borrowed)
+int fbg_allocFragmentBuffers(struct _fbg_fragment *fragment, int count, int min_count, int size, int shared) {
+    fragment->sync_wait = (struct _fbg_sync *)calloc(count, sizeof(struct _fbg_sync));
+    if (!fragment->sync_wait) {
+        fprintf(stderr, "fbg_allocFragmentBuffers: sync_wait calloc failed!\n");
+
+        return 0;
+    }
+
+    fragment->buffers_count = count;
+
+    fragment->write_index = 0;
+    fragment->read_index = 0;
+
+    fragment->buffers_frame = (struct _fbg_frame_info *)calloc(count, sizeof(struct _fbg_frame_info));
+    if (!fragment->buffers_frame) {
+        fprintf(stderr, "fbg_allocFragmentBuffers: buffers_frame calloc failed!\n");
+
+        fbg_freeFragmentBuffers(fragment);
+
+        return 0;
+    }
+
+    if (shared) {
+        return 1;
+    }
+
+    fragment->buffers = (unsigned char **)calloc(count, sizeof(unsigned char *));
+    if (!fragment->buffers) {
+        fprintf(stderr, "fbg_allocFragmentBuffers: buffers calloc failed!\n");
+
+        fbg_freeFragmentBuffers(fragment);
+
+        return 0;
+    }
+
+    int i = 0;
+    for (i = 0; i < count; i += 1) {
+        fragment->buffers[i] = fbg_borrowBuffer(fragment->buffer_pool, size, i < min_count);
+        if (!fragment->buffers[i]) {
+            break;
+        }
+    }
+
+    if (i < min_count) {
+        fprintf(stderr, "fbg_allocFragmentBuffers: buffer borrowing failed!\n");
+
+        fbg_freeFragmentBuffers(fragment);
+
+        return 0;
+    }
+
+    fragment->buffers_count = i;
+    fragment->buffers_size = size;
+
+    return 1;
+}
+
+void fbg_freeFragmentBuffers(struct _fbg_fragment *fragment) {
+    int i = 0;
+    if (fragment->buffers) {
+        for (i = 0; i < fragment->buffers_count; i += 1) {
+            fbg_returnBuffer(fragment->buffer_pool, fragment->buffers[i]);
+        }
+    }
+
+    free(fragment->buffers);
+    free(fragment->sync_wait);
+    free(fragment->buffers_frame);
+
+    fragment->buffers = NULL;
+    fragment->sync_wait = NULL;
+    fragment->buffers_frame = NULL;
+    fragment->buffers_count = 0;
+    fragment->buffers_size = 0;
+
+#ifdef FBG_LFDS
+    if (fragment->fbg_freelist_data) {
+        for (i = 0; i < fragment->freelist_size; i += 1) {
+            fbg_returnBuffer(fragment->buffer_pool, fragment->fbg_freelist_data[i].buffer);
+        }
+    }
+
+    if (fragment->ringbuffer) {
+        free(fragment->ringbuffer->slots);
+    }
+
+    free(fragment->fbg_freelist_data);
+    free(fragment->ringbuffer);
+
+    fragment->fbg_freelist_data = NULL;
+    fragment->ringbuffer = NULL;
+    fragment->freelist_size = 0;
+#endif
+}
+
+#ifdef FBG_LFDS
+// allocate the fragment freelist (count buffers borrowed from the buffer pool, see fbg_allocFragmentBuffers()) and its ringbuffer
+// the ringbuffer hold up to count - 2 buffers (one is drawn by the fragment, one is mixed) so that the fragment overwrite the oldest buffer instead of waiting
+int fbg_allocFragmentQueue(struct _fbg_fragment *fragment, int count, int min_count, int size) {
+    fragment->fbg_freelist_data = (struct _fbg_freelist_data *)aligned_alloc(FBG_CACHE_LINE_SIZE, sizeof(struct _fbg_freelist_data) * count);
+    if (!fragment->fbg_freelist_data) {
+        fprintf(stderr, "fbg_allocFragmentQueue: fbg_freelist_data aligned_alloc failed!\n");
+
+        return 0;
+    }
+
+    memset(fragment->fbg_freelist_data, 0, sizeof(struct _fbg_freelist_data) * count);
+
+    int i = 0;
+    for (i = 0; i < count; i += 1) {
+        fragment->fbg_freelist_data[i].buffer = fbg_borrowBuffer(fragment->buffer_pool, size, i < min_count);
+        if (!fragment->fbg_freelist_data[i].buffer) {
+            break;
+        }
+
+        fragment->freelist_size = i + 1;
+
+        atomic_store(&fragment->fbg_freelist_data[i].free, 1);
+    }
+
+    if (fragment->freelist_size < min_count) {
+        fprintf(stderr, "fbg_allocFragmentQueue: buffer borrowing failed!\n");
+
+        fbg_freeFragmentBuffers(fragment);
+
+        return 0;
+    }
+
+    fragment->buffers_size = size;
+
+    fragment->ringbuffer = (struct _fbg_ringbuffer *)aligned_alloc(FBG_CACHE_LINE_SIZE, sizeof(struct _fbg_ringbuffer));
+    if (!fragment->ringbuffer) {
+        fprintf(stderr, "fbg_allocFragmentQueue: ringbuffer aligned_alloc failed!\n");
+
+        fbg_freeFragmentBuffers(fragment);
+
+        return 0;
+    }
+
+    memset(fragment->ringbuffer, 0, sizeof(struct _fbg_ringbuffer));
+
+    fragment->ringbuffer->size = _FBG_MAX(fragment->freelist_size - 2, 1);
+
+    fragment->ringbuffer->slots = (struct _fbg_freelist_data *_Atomic *)calloc(fragment->ringbuffer->size, sizeof(struct _fbg_freelist_data *_Atomic));
+    if (!fragment->ringbuffer->slots) {
+        fprintf(stderr, "fbg_allocFragmentQueue: slots calloc failed!\n");
+
+        fbg_freeFragmentBuffers(fragment);
+
+        return 0;
+    }
+
+    return 1;
+}
+
+// take a buffer from the freelist (fragment thread), NULL when all buffers are in use
+struct _fbg_freelist_data *fbg_freelistPop(struct _fbg_fragment *fragment) {
+    int i = 0;
+    for (i = 0; i < fragment->freelist_size; i += 1) {
+        struct _fbg_freelist_data *freelist_data = &fragment->fbg_freelist_data[i];
+
+        int expected = 1;
+        if (atomic_compare_exchange_strong_explicit(&freelist_data->free, &expected, 0, memory_order_acquire, memory_order_relaxed)) {
+            return freelist_data;
+        }
+    }
+
+    return NULL;
+}
+
+// put a buffer back into the freelist (fragment or main thread) and wake the fragment if it was waiting for one
+void fbg_freelistPush(struct _fbg_fragment *fragment, struct _fbg_freelist_data *freelist_data) {
+    atomic_store_explicit(&freelist_data->free, 1, memory_order_release);
+
+    atomic_fetch_add(&fragment->ringbuffer->freed.value, 1);
+
+    fbg_wakeSync(&fragment->ringbuffer->freed);
+}
+
+// write into the ringbuffer (fragment thread), return the overwritten (oldest) data when it was full, NULL otherwise
+struct _fbg_freelist_data *fbg_ringbufferWrite(struct _fbg_ringbuffer *ringbuffer, struct _fbg_freelist_data *freelist_data) {
+    struct _fbg_freelist_data *overwritten_data = NULL;
+
+    unsigned int write_index = atomic_load_explicit(&ringbuffer->write_index, memory_order_relaxed);
+    unsigned int read_index = atomic_load_explicit(&ringbuffer->read_index, memory_order_acquire);
+
+    // full : take the oldest data away from fbg_draw(), if fbg_draw() got it first there is room again
+    while (write_index - read_index >= ringbuffer->size) {
+        overwritten_data = atomic_load_explicit(&ringbuffer->slots[read_index % ringbuffer->size], memory_order_relaxed);
+
+        if (atomic_compare_exchange_weak_explicit(&ringbuffer->read_index, &read_index, read_index + 1, memory_order_acq_rel, memory_order_acquire)) {
+            break;
+        }
+
+        overwritten_data = NULL;
+    }
+
+    atomic_store_explicit(&ringbuffer->slots[write_index % ringbuffer->size], freelist_data, memory_order_relaxed);
+    atomic_store_explicit(&ringbuffer->write_index, write_index + 1, memory_order_release);
+
+    atomic_fetch_add(&ringbuffer->written.value, 1);
+
+    fbg_wakeSync(&ringbuffer->written);
+
+    return overwritten_data;
+}
+
+// read the oldest data of the ringbuffer (main thread), NULL when empty
+struct _fbg_freelist_data *fbg_ringbufferRead(struct _fbg_ringbuffer *ringbuffer) {
+    struct _fbg_freelist_data *freelist_data = NULL;
+
+    unsigned int read_index = atomic_load_explicit(&ringbuffer->read_index, memory_order_acquire);
+
+    do {
+        if (read_index == atomic_load_explicit(&ringbuffer->write_index, memory_order_acquire)) {
+            return NULL;
+        }
+
+        freelist_data = atomic_load_explicit(&ringbuffer->slots[read_index % ringbuffer->size], memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&ringbuffer->read_index, &read_index, read_index + 1, memory_order_acq_rel, memory_order_acquire));
+
+    return freelist_data;
+}
+#endif
+
+void fbg_fragmentPull(struct _fbg_fragment *fbg_fragment) {
+    if (fbg_fragment->sync_wait) {
+        int index = fbg_fragment->write_index;
+
+        // pooled fragments never wait : the queue is full so fbg_draw() has a frame to mix already
+        if (fbg_fragment->pooled && atomic_load(&fbg_fragment->sync_wait[index].value)) {
+            fbg_fragment->fbg->back_buffer = NULL;
+
+            return;
+        }
+
+        // wait till the buffer is consumed (spin then sleep, see fbg_setWaitSpin)
+        fbg_waitSync(&fbg_fragment->sync_wait[index], 1, &fbg_fragment->state, fbg_fragment->fbg->wait_spin, fbg_fragment->pool, &fbg_fragment->wait_time, &fbg_fragment->wait_sleeps);
+
+        // the buffer hold what was drawn into it queue_size frames ago
+        fbg_fragment->fbg->dirty = fbg_fragment->buffers_frame[index].dirty;
+
+        if (fbg_fragment->state != FBG_FRAGMENT_RUNNING) {
+            fbg_fragment->fbg->back_buffer = NULL;
+        } else if (fbg_fragment->buffers) {
+            fbg_fragment->fbg->back_buffer = fbg_fragment->buffers[index];
+        } else {
+            fbg_fragment->fbg->back_buffer = *fbg_fragment->shared_buffer + fbg_fragment->shared_offset;
+        }
+
+        return;
+    }
+
+#ifdef FBG_LFDS
+    struct _fbg_ringbuffer *ringbuffer = fbg_fragment->ringbuffer;
+    struct _fbg_freelist_data *freelist_data = NULL;
+
+    while (atomic_load(&fbg_fragment->state) == FBG_FRAGMENT_RUNNING) {
+        int freed = atomic_load(&ringbuffer->freed.value);
+
+        freelist_data = fbg_freelistPop(fbg_fragment);
+        if (freelist_data || fbg_fragment->pooled) {
+            break;
+        }
+
+        // all buffers are in use (fbg_draw() is late and the queue is too short to overwrite), help the main thread meanwhile
+        fbg_waitSync(&ringbuffer->freed, freed, &fbg_fragment->state, fbg_fragment->fbg->wait_spin, fbg_fragment->pool, &fbg_fragment->wait_time, &fbg_fragment->wait_sleeps);
+    }
+
+    fbg_fragment->tmp_fbg_freelist_data = freelist_data;
+
+    if (freelist_data) {
+        fbg_fragment->fbg->dirty = freelist_data->frame.dirty;
+    }
+
+    fbg_fragment->fbg->back_buffer = freelist_data ? freelist_data->buffer : NULL;
+#endif
+}
+
+void fbg_fragmentPush(struct _fbg_fragment *fbg_fragment) {
+    struct _fbg_frame_info frame;
+    frame.sequence = atomic_fetch_add_explicit(&fbg_fragment->frames, 1, memory_order_relaxed);
+    frame.timestamp = fbg_timeNs();
+
+    if (fbg_fragment->fbg->dirty_tracking) {
+        frame.dirty = fbg_fragment->fbg->dirty;
+    } else {
+        frame.dirty.x1 = 0;
+        frame.dirty.y1 = 0;
+        frame.dirty.x2 = fbg_fragment->fbg->width;
+        frame.dirty.y2 = fbg_fragment->fbg->height;
+    }
+
+    frame.unchanged = fbg_fragment->fbg->idle.unchanged;
+    fbg_fragment->fbg->idle.unchanged = 0;
+
+    if (fbg_fragment->sync_wait) {
+        int index = fbg_fragment->write_index;
+
+        fbg_fragment->buffers_frame[index] = frame;
+
+        fbg_fragment->write_index = (index + 1) % fbg_fragment->buffers_count;
+
+        fbg_setSync(&fbg_fragment->sync_wait[index], 1);
+
+        return;
+    }
+
+#ifdef FBG_LFDS
+    fbg_fragment->tmp_fbg_freelist_data->frame = frame;
+
+    struct _fbg_freelist_data *overwritten_data = fbg_ringbufferWrite(fbg_fragment->ringbuffer, fbg_fragment->tmp_fbg_freelist_data);
+    if (overwritten_data) {
+#ifdef DEBUG
+        fprintf(stderr, "fbg_fragmentPush: Overwrite occured.\n");
+        fflush(stdout);
+#endif
+
+        atomic_fetch_add_explicit(&fbg_fragment->overwrites, 1, memory_order_relaxed);
+
+        // okay, push it back!
+        fbg_freelistPush(fbg_fragment, overwritten_data);
+    }
+
+    fbg_fragment->tmp_fbg_freelist_data = NULL;
+#endif
+}
+
+// clear the fragment own buffers (none of them are in use)
+void fbg_clearFragmentBuffers(struct _fbg_fragment *fbg_fragment) {
+    int i = 0;
+    for (i = 0; i < fbg_fragment->buffers_count && fbg_fragment->buffers; i += 1) {
+        memset(fbg_fragment->buffers[i], 0, fbg_fragment->buffers_size);
+    }
+
+#ifdef FBG_LFDS
+    for (i = 0; i < fbg_fragment->freelist_size; i += 1) {
+        memset(fbg_fragment->fbg_freelist_data[i].buffer, 0, fbg_fragment->buffers_size);
+    }
+#endif
+}
+
+// parked by fbg_parkFragments() : acknowledge and wait till resumed (or terminated)
+void fbg_fragmentPark(struct _fbg_fragment *fbg_fragment) {
+    // the context is changed by the calling thread once acknowledged
+    int wait_spin = fbg_fragment->fbg->wait_spin;
+
+    atomic_int running = FBG_FRAGMENT_RUNNING;
+
+    fbg_setSync(&fbg_fragment->parked, 1);
+
+    fbg_waitSync(&fbg_fragment->parked, 1, &running, wait_spin, NULL, NULL, NULL);
+}
+
+void fbg_fragment(struct _fbg_fragment *fbg_fragment) {
+    struct _fbg *fbg = fbg_fragment->fbg;
+
+    // stop function of the current user data (user functions may change while parked)
+    void (*user_fragment_stop)(struct _fbg *fbg, void *user_data) = fbg_fragment->user_fragment_stop;
+
+    //fprintf(stdout, "fbg_fragment: Task started\n");
+
+    if (fbg_fragment->user_fragment_start) {
+        fbg_fragment->user_data = fbg_fragment->user_fragment_start(fbg);
+    } else {
+        fbg_fragment->user_data = NULL;
+    }
+
+    while (fbg_fragment->state) {
+        if (fbg_fragment->state == FBG_FRAGMENT_PARKED) {
+            fbg_fragmentPark(fbg_fragment);
+
+            if (fbg_fragment->restart && fbg_fragment->state) {
+                if (user_fragment_stop) {
+                    user_fragment_stop(fbg, fbg_fragment->user_data);
+                }
+
+                user_fragment_stop = fbg_fragment->user_fragment_stop;
+
+                if (fbg_fragment->user_fragment_start) {
+                    fbg_fragment->user_data = fbg_fragment->user_fragment_start(fbg);
+                } else {
+                    fbg_fragment->user_data = NULL;
+                }
+
+                fbg_fragment->restart = 0;
+            }
+
+            // reused buffers, cleared here so that fragments do it in parallel
+            if (fbg_fragment->clear_buffers && fbg_fragment->state) {
+                fbg_clearFragmentBuffers(fbg_fragment);
+
+                fbg_fragment->clear_buffers = 0;
+            }
+
+            continue;
+        }
+
+        fbg_fragmentPull(fbg_fragment);
+
+        if (fbg->back_buffer == NULL) {
+            // terminated / parked while waiting for a buffer
+            continue;
+        }
+
+        uint64_t render_start = fbg_timeNs();
+
+        // execute user fragment
+        fbg_fragment->user_fragment(fbg, fbg_fragment->user_data);
+
+        atomic_fetch_add_explicit(&fbg_fragment->render_time, fbg_timeNs() - render_start, memory_order_relaxed);
+
+        // wait till all fragments are completed (fragments run freely with FBG_DRAW_LATEST)
+        if (fbg->sync_barrier) {
+            fbg_barrierWait(fbg->sync_barrier, fbg_fragment);
+        }
+
+        // push to main thread
+        fbg_fragmentPush(fbg_fragment);
+
+        fbg_computeFramerate(fbg, 0);
+    }
+
+    if (user_fragment_stop) {
+        user_fragment_stop(fbg, fbg_fragment->user_data);
+    }
+
+    //fprintf(stdout, "fbg_fragment: Task ended successfully.\n");
+}
+
+// work item of a pooled fragments frame job : draw a frame of the fragment of that index (see fbg_sharePool())
+void fbg_runFragment(struct _fbg_job *job, int index) {
+    struct _fbg *main_fbg = (struct _fbg *)job->data;
+    struct _fbg_fragment *fbg_fragment = main_fbg->fragments[index];
+    struct _fbg *fbg = fbg_fragment->fbg;
+
+    if (fbg_fragment->state != FBG_FRAGMENT_RUNNING) {
+        return;
+    }
+
+    // user functions changed (see fbg_fragment())
+    if (fbg_fragment->restart) {
+        if (fbg_fragment->started && fbg_fragment->started_stop) {
+            fbg_fragment->started_stop(fbg, fbg_fragment->user_data);
+        }
+
+        fbg_fragment->started = 0;
+        fbg_fragment->restart = 0;
+    }
+
+    if (!fbg_fragment->started) {
+        if (fbg_fragment->user_fragment_start) {
+            fbg_fragment->user_data = fbg_fragment->user_fragment_start(fbg);
+        } else {
+            fbg_fragment->user_data = NULL;
+        }
+
+        fbg_fragment->started_stop = fbg_fragment->user_fragment_stop;
+        fbg_fragment->started = 1;
+    }
+
+    if (fbg_fragment->clear_buffers) {
+        fbg_clearFragmentBuffers(fbg_fragment);
+
+        fbg_fragment->clear_buffers = 0;
+    }
+
+    fbg_fragmentPull(fbg_fragment);
+
+    if (fbg->back_buffer == NULL) {
+        return;
+    }
+
+    uint64_t render_start = fbg_timeNs();
+
+    fbg_fragment->user_fragment(fbg, fbg_fragment->user_data);
+
+    atomic_fetch_add_explicit(&fbg_fragment->render_time, fbg_timeNs() - render_start, memory_order_relaxed);
+
+    fbg_fragmentPush(fbg_fragment);
+
+    fbg_computeFramerate(fbg, 0);
+}
+
+// submit the next frame of pooled fragments unless the previous one is still running
+void fbg_submitFragments(struct _fbg *fbg) {
+    if (!fbg->fragments_pooled || fbg->parallel_tasks < 1 || atomic_load(&fbg->fragments_group.pending) > 0) {
+        return;
+    }
+
+    struct _fbg_job desc;
+    memset(&desc, 0, sizeof(struct _fbg_job));
+    desc.fn = fbg_runFragment;
+    desc.data = fbg;
+    desc.count = fbg->parallel_tasks;
+
+    fbg_submitJob(fbg, &fbg->fragments_group, &desc);
+}
+
+void fbg_setFragmentQueueSize(struct _fbg *fbg, unsigned int queue_size) {
+    fbg->fragment_queue_size = _FBG_MAX(queue_size, 1);
+}
+
+void fbg_setWaitSpin(struct _fbg *fbg, int spin_time) {
+    fbg->wait_spin = _FBG_MAX(spin_time, -1);
+
+    atomic_store(&fbg->pool->wait_spin, fbg->wait_spin);
+
+    int i = 0;
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        fbg->fragments[i]->fbg->wait_spin = fbg->wait_spin;
+    }
+}
+
+int fbg_getFragmentDirty(struct _fbg *fbg, int task_id, struct _fbg_bbox *dirty) {
+    if (task_id < 1 || task_id > fbg->parallel_tasks) {
+        return 0;
+    }
+
+    struct _fbg_bbox *mixing_dirty = &fbg->fragments[task_id - 1]->mixing_frame.dirty;
+
+    dirty->x1 = _FBG_MAX(mixing_dirty->x1 - fbg->region.x, 0);
+    dirty->y1 = _FBG_MAX(mixing_dirty->y1 - fbg->region.y, 0);
+    dirty->x2 = _FBG_MIN(mixing_dirty->x2 - fbg->region.x, fbg->width);
+    dirty->y2 = _FBG_MIN(mixing_dirty->y2 - fbg->region.y, fbg->height);
+
+    return 1;
+}
+
+void fbg_setFramePacing(struct _fbg *fbg, int frame_time) {
+    fbg->frame_pacing = (uint64_t)_FBG_MAX(frame_time, 0) * 1000;
+    fbg->next_flip = 0;
+}
+
+// wait till the context next frame time (called by fbg_flip())
+void fbg_paceFrame(struct _fbg *fbg) {
+    uint64_t now = fbg_timeNs();
+
+    if (fbg->next_flip > now) {
+        struct timespec t;
+        t.tv_sec = fbg->next_flip / 1000000000ull;
+        t.tv_nsec = fbg->next_flip % 1000000000ull;
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR);
+    } else if (now - fbg->next_flip > fbg->frame_pacing) {
+        // first frame or late by more than a frame : start again from now instead of catching up
+        fbg->next_flip = now;
+    }
+
+    fbg->next_flip += fbg->frame_pacing;
+}
+
+void fbg_setDrawPolicy(struct _fbg *fbg, enum _fbg_draw_policy policy) {
+    fbg->draw_policy = policy;
+}
+
+int fbg_getFragmentStats(struct _fbg *fbg, int task_id, struct _fbg_fragment_stats *stats) {
+    if (task_id < 1 || task_id > fbg->parallel_tasks) {
+        return 0;
+    }
+
+    struct _fbg_fragment *fragment = fbg->fragments[task_id - 1];
+
+    stats->frames = atomic_load_explicit(&fragment->frames, memory_order_relaxed);
+    stats->wait_time = atomic_load_explicit(&fragment->wait_time, memory_order_relaxed);
+    stats->wait_sleeps = atomic_load_explicit(&fragment->wait_sleeps, memory_order_relaxed);
+    stats->draw_wait_time = atomic_load_explicit(&fragment->draw_wait_time, memory_order_relaxed);
+    stats->draw_wait_sleeps = atomic_load_explicit(&fragment->draw_wait_sleeps, memory_order_relaxed);
+    stats->overwrites = atomic_load_explicit(&fragment->overwrites, memory_order_relaxed);
+    stats->drops = atomic_load_explicit(&fragment->drops, memory_order_relaxed);
+    stats->reuses = atomic_load_explicit(&fragment->reuses, memory_order_relaxed);
+    stats->render_time = atomic_load_explicit(&fragment->render_time, memory_order_relaxed);
+#ifdef FBG_LFDS
+    stats->buffers = fragment->sync_wait ? fragment->buffers_count : fragment->freelist_size;
+#else
+    stats->buffers = fragment->buffers_count;
+#endif
+    stats->sequence = fragment->mixing_frame.sequence;
+    stats->timestamp = fragment->mixing_frame.timestamp;
+
+    return 1;
+}
+
+// start a new adaptive fragments window (fragments counters are read again)
+void fbg_resetAdaptiveWindow(struct _fbg *fbg) {
+    struct _fbg_adaptive *adaptive = &fbg->adaptive;
+
+    adaptive->frames = 0;
+    adaptive->last_flip = 0;
+    adaptive->frame_time = 0;
+    adaptive->mixing_time = 0;
+    adaptive->flip_time = 0;
+    adaptive->render_time = 0;
+    adaptive->render_frames = 0;
+
+    int i = 0;
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        adaptive->render_time += atomic_load_explicit(&fbg->fragments[i]->render_time, memory_order_relaxed);
+        adaptive->render_frames += atomic_load_explicit(&fbg->fragments[i]->frames, memory_order_relaxed);
+    }
+}
+
+void fbg_setAdaptiveFragments(struct _fbg *fbg, int target_frame_time, int min_tasks, int max_tasks, int window) {
+    struct _fbg_adaptive *adaptive = &fbg->adaptive;
+
+    adaptive->target_time = (uint64_t)_FBG_MAX(target_frame_time, 0) * 1000;
+    adaptive->min_tasks = _FBG_MAX(min_tasks, 1);
+
+    if (max_tasks <= 0) {
+#ifdef __linux__
+        max_tasks = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+        max_tasks = adaptive->min_tasks;
+#endif
+    }
+
+    adaptive->max_tasks = _FBG_MAX(max_tasks, adaptive->min_tasks);
+    adaptive->window = (window > 0) ? window : 30;
+
+    memset(&adaptive->stats, 0, sizeof(struct _fbg_adaptive_stats));
+
+    fbg_resetAdaptiveWindow(fbg);
+}
+
+int fbg_getAdaptiveStats(struct _fbg *fbg, struct _fbg_adaptive_stats *stats) {
+    *stats = fbg->adaptive.stats;
+
+    stats->tasks = fbg->parallel_tasks;
+
+    return (fbg->adaptive.target_time > 0);
+}
+
+// measure a frame (called by fbg_flip()), once a window is complete grow or shrink the fragments count according to the average times
+void fbg_adaptFragments(struct _fbg *fbg, uint64_t flip_start, uint64_t flip_end) {
+    struct _fbg_adaptive *adaptive = &fbg->adaptive;
+
+    int tasks = fbg->parallel_tasks;
+    if (tasks < 1) {
+        return;
+    }
+
+    // the first frame of a window only give its start time
+    if (adaptive->last_flip) {
+        adaptive->frame_time += flip_end - adaptive->last_flip;
+        adaptive->flip_time += flip_end - flip_start;
+        adaptive->frames += 1;
+    } else {
+        adaptive->mixing_time = 0;
+    }
+
+    adaptive->last_flip = flip_end;
+
+    if (adaptive->frames < adaptive->window) {
+        return;
+    }
+
+    uint64_t render_time = 0, render_frames = 0;
+
+    int i = 0;
+    for (i = 0; i < tasks; i += 1) {
+        render_time += atomic_load_explicit(&fbg->fragments[i]->render_time, memory_order_relaxed);
+        render_frames += atomic_load_explicit(&fbg->fragments[i]->frames, memory_order_relaxed);
+    }
+
+    struct _fbg_adaptive_stats *stats = &adaptive->stats;
+
+    stats->frame_time = adaptive->frame_time / adaptive->frames;
+    stats->mixing_time = adaptive->mixing_time / adaptive->frames;
+    stats->flip_time = adaptive->flip_time / adaptive->frames;
+    stats->render_time = (render_frames > adaptive->render_frames) ? (render_time - adaptive->render_time) / (render_frames - adaptive->render_frames) : 0;
+    stats->windows += 1;
+
+    uint64_t target_time = adaptive->target_time;
+
+    // fragments drawing area shrink with their count in split rendering mode, each fragment buffer cost a mixing pass otherwise
+    int split = (fbg->split_mode != FBG_SPLIT_NONE && fbg->split_mode != FBG_SPLIT_PASSTHROUGH);
+
+    int new_tasks = tasks;
+    if (_FBG_MAX(stats->frame_time, stats->render_time) > target_time) {
+        if (stats->render_time >= stats->mixing_time + stats->flip_time) {
+            new_tasks = _FBG_MIN(tasks + 1, adaptive->max_tasks);
+        } else if (!split) {
+            new_tasks = _FBG_MAX(tasks - 1, adaptive->min_tasks);
+        }
+    } else if (tasks > adaptive->min_tasks) {
+        // estimation of the frame time with one less fragment (drawing area grow or one less mixing pass), it must fit with a 10% margin to avoid changing back and forth
+        uint64_t frame_estimate = stats->frame_time;
+        if (split) {
+            frame_estimate += stats->render_time / (tasks - 1);
+        } else {
+            frame_estimate -= _FBG_MIN(stats->mixing_time / tasks, frame_estimate);
+        }
+
+        if (frame_estimate < target_time - target_time / 10) {
+            new_tasks = tasks - 1;
+        }
+    }
+
+    if (new_tasks == tasks) {
+        stats->decision = FBG_ADAPTIVE_KEEP;
+
+        fbg_resetAdaptiveWindow(fbg);
+
+        return;
+    }
+
+    stats->decision = (new_tasks > tasks) ? FBG_ADAPTIVE_GROW : FBG_ADAPTIVE_SHRINK;
+    stats->changes += 1;
+
+    struct _fbg_fragment *frag = fbg->fragments[0];
+
+    // the window is reset by the reconfiguration so that the change hitch is not measured
+    fbg_updateFragments(fbg, frag->user_fragment_start, frag->user_fragment, frag->user_fragment_stop, new_tasks, 0);
+}
+
+void fbg_setFragmentSplit(struct _fbg *fbg, enum _fbg_split_mode mode, int columns) {
+    fbg->split_mode = mode;
+    fbg->split_columns = _FBG_MAX(columns, 0);
+}
+
+struct _fbg_thread_settings *fbg_getThreadSettings(struct _fbg *fbg, int task_id) {
+    static struct _fbg_thread_settings default_settings = { FBG_CPU_ANY, SCHED_OTHER, 0, 0 };
+
+    if (task_id < 0 || task_id >= fbg->thread_settings_count) {
+        return (task_id != 0 && fbg->thread_settings_count > 0) ? &fbg->thread_settings[0] : &default_settings;
+    }
+
+    return &fbg->thread_settings[task_id];
+}
+
+struct _fbg_thread_settings *fbg_allocThreadSettings(struct _fbg *fbg, int task_id) {
+    if (task_id < 0) {
+        return NULL;
+    }
+
+    if (task_id >= fbg->thread_settings_count) {
+        struct _fbg_thread_settings *thread_settings = (struct _fbg_thread_settings *)realloc(fbg->thread_settings, sizeof(struct _fbg_thread_settings) * (task_id + 1));
+        if (!thread_settings) {
+            fprintf(stderr, "fbg_allocThreadSettings: thread_settings realloc failed!\n");
+
+            return NULL;
+        }
+
+        // new tasks settings start from the default one
+        int i = 0;
+        for (i = fbg->thread_settings_count; i <= task_id; i += 1) {
+            thread_settings[i] = (i > 0) ? thread_settings[0] : *fbg_getThreadSettings(fbg, -1);
+        }
+
+        fbg->thread_settings = thread_settings;
+        fbg->thread_settings_count = task_id + 1;
+    }
+
+    return &fbg->thread_settings[task_id];
+}
+
+void fbg_setFragmentAffinity(struct _fbg *fbg, int task_id, int cpu) {
+    struct _fbg_thread_settings *settings = fbg_allocThreadSettings(fbg, task_id);
+    if (!settings) {
+        return;
+    }
+
+    settings->cpu = _FBG_MAX(cpu, FBG_CPU_AUTO);
+}
+
+void fbg_setFragmentScheduling(struct _fbg *fbg, int task_id, int policy, int priority) {
+    struct _fbg_thread_settings *settings = fbg_allocThreadSettings(fbg, task_id);
+    if (!settings) {
+        return;
+    }
+
+    settings->policy = policy;
+    settings->priority = priority;
+}
+
+void fbg_setFragmentStackSize(struct _fbg *fbg, int task_id, size_t stack_size) {
+    struct _fbg_thread_settings *settings = fbg_allocThreadSettings(fbg, task_id);
+    if (!settings) {
+        return;
+    }
+
+    settings->stack_size = stack_size;
+}
+
+int fbg_reserveCore(struct _fbg *fbg, int cpu) {
+    fbg->reserved_cpu = _FBG_MAX(cpu, -1);
+
+#if defined(__linux__) && defined(CPU_SETSIZE)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    int i = 0;
+    for (i = 0; i < sysconf(_SC_NPROCESSORS_ONLN) && i < CPU_SETSIZE; i += 1) {
+        if (cpu < 0 || i == cpu) {
+            CPU_SET(i, &cpu_set);
+        }
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+    if (err) {
+        fprintf(stderr, "fbg_reserveCore: pthread_setaffinity_np error '%i'!\n", err);
+
+        return 0;
+    }
+
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+// initialize thread attributes with the task settings (stack size)
+void fbg_initThreadAttr(struct _fbg *fbg, pthread_attr_t *attr, int task_id) {
+    struct _fbg_thread_settings *settings = fbg_getThreadSettings(fbg, task_id);
+
+    pthread_attr_init(attr);
+
+    if (settings->stack_size > 0) {
+        int err = pthread_attr_setstacksize(attr, settings->stack_size);
+        if (err) {
+            fprintf(stderr, "fbg_initThreadAttr: pthread_attr_setstacksize error '%i'!\n", err);
+        }
+    }
+}
+
+// apply the task affinity / scheduling settings to a running thread, index is the thread rank used by FBG_CPU_AUTO
+void fbg_applyThreadSettings(struct _fbg *fbg, pthread_t thread, int task_id, int index) {
+    struct _fbg_thread_settings *settings = fbg_getThreadSettings(fbg, task_id);
+
+    int err = 0;
+
+#if defined(__linux__) && defined(CPU_SETSIZE)
+    int cpus = _FBG_MIN((int)sysconf(_SC_NPROCESSORS_ONLN), CPU_SETSIZE);
+    int reserved_cpu = (fbg->reserved_cpu < cpus && cpus > 1) ? fbg->reserved_cpu : -1;
+
+    int cpu = settings->cpu;
+    if (cpu == FBG_CPU_AUTO) {
+        cpu = index % (cpus - (reserved_cpu >= 0));
+
+        if (reserved_cpu >= 0 && cpu >= reserved_cpu) {
+            cpu += 1;
+        }
+    }
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    int i = 0;
+    for (i = 0; i < cpus; i += 1) {
+        if ((cpu < 0 && i != reserved_cpu) || i == cpu) {
+            CPU_SET(i, &cpu_set);
+        }
+    }
+
+    err = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpu_set);
+    if (err) {
+        fprintf(stderr, "fbg_applyThreadSettings: pthread_setaffinity_np error '%i'!\n", err);
+    }
+#endif
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(struct sched_param));
+    param.sched_priority = settings->priority;
+
+    err = pthread_setschedparam(thread, settings->policy, &param);
+    if (err) {
+        fprintf(stderr, "fbg_applyThreadSettings: pthread_setschedparam error '%i'!\n", err);
+    }
+}
+
+// split mode used by the fragments, FBG_SPLIT_PASSTHROUGH give the whole display to every fragment so it is only used by a single fragment (several ones are mixed)
+enum _fbg_split_mode fbg_fragmentSplit(struct _fbg *fbg) {
+    if (fbg->split_mode == FBG_SPLIT_PASSTHROUGH && fbg->parallel_tasks > 1) {
+        return FBG_SPLIT_NONE;
+    }
+
+    return fbg->split_mode;
+}
+
+// compute the area of the display drawn by a fragment in split rendering mode, return the area offset in the back buffer
+int fbg_fragmentRegion(struct _fbg *fbg, struct _fbg *task_fbg, int index) {
+    int count = fbg->parallel_tasks;
+
+    int x = 0, y = 0;
+    int width = fbg->width, height = fbg->height;
+    int line_length = fbg->line_length;
+    int row_step = 1;
+
+    if (fbg->split_mode == FBG_SPLIT_BANDS) {
+        y = index * fbg->height / count;
+        height = (index + 1) * fbg->height / count - y;
+    } else if (fbg->split_mode == FBG_SPLIT_ROWS) {
+        y = index;
+        height = _FBG_MAX(fbg->height - index + count - 1, 0) / count;
+        row_step = count;
+        line_length = fbg->line_length * count;
+    } else if (fbg->split_mode == FBG_SPLIT_TILES) {
+        int columns = fbg->split_columns;
+        if (columns == 0) {
+            columns = (int)ceilf(sqrtf((float)count));
+        }
+        columns = _FBG_MIN(columns, count);
+
+        int rows = (count + columns - 1) / columns;
+
+        int row = index / columns;
+        int column = index % columns;
+        // last row tiles are stretched when there is less of them
+        int row_columns = (row == rows - 1) ? (count - row * columns) : columns;
+
+        x = column * fbg->width / row_columns;
+        width = (column + 1) * fbg->width / row_columns - x;
+        y = row * fbg->height / rows;
+        height = (row + 1) * fbg->height / rows - y;
+    }
+    // FBG_SPLIT_PASSTHROUGH : the whole display
+
+    task_fbg->width = width;
+    task_fbg->height = height;
+    task_fbg->line_length = line_length;
+
+    task_fbg->region.x = x;
+    task_fbg->region.y = y;
+    task_fbg->region.row_step = row_step;
+    task_fbg->region.display_width = fbg->width;
+    task_fbg->region.display_height = fbg->height;
+
+    return y * fbg->line_length + x * fbg->components;
+}
+
+// reuse the fragment buffers when they match the requested ones (the queue is emptied, buffers are cleared by the fragment once resumed), return 0 if they must be allocated again
+int fbg_resetFragmentBuffers(struct _fbg_fragment *fragment, int count, int size, int shared) {
+    int i = 0;
+
+    fragment->clear_buffers = !shared;
+
+#ifdef FBG_LFDS
+    if (!shared) {
+        if (!fragment->ringbuffer || fragment->freelist_size != count || fragment->buffers_size < size) {
+            return 0;
+        }
+
+        struct _fbg_ringbuffer *ringbuffer = fragment->ringbuffer;
+
+        atomic_store(&ringbuffer->write_index, 0);
+        atomic_store(&ringbuffer->read_index, 0);
+
+        for (i = 0; i < (int)ringbuffer->size; i += 1) {
+            atomic_store(&ringbuffer->slots[i], NULL);
+        }
+
+        for (i = 0; i < count; i += 1) {
+            struct _fbg_freelist_data *freelist_data = &fragment->fbg_freelist_data[i];
+
+            memset(&freelist_data->frame, 0, sizeof(struct _fbg_frame_info));
+
+            atomic_store(&freelist_data->free, 1);
+        }
+
+        return 1;
+    }
+#endif
+
+    if (!fragment->sync_wait || fragment->buffers_count != count || (shared ? (fragment->buffers != NULL) : (!fragment->buffers || fragment->buffers_size < size))) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i += 1) {
+        memset(&fragment->buffers_frame[i], 0, sizeof(struct _fbg_frame_info));
+
+        atomic_store(&fragment->sync_wait[i].value, 0);
+    }
+
+    fragment->write_index = 0;
+    fragment->read_index = 0;
+
+    return 1;
+}
+
+// apply the main context settings to a fragment (context, buffers), the fragment must be parked or not started yet
+int fbg_setupFragment(struct _fbg *fbg, struct _fbg_fragment *frag, int index) {
+    struct _fbg *task_fbg = frag->fbg;
+
+    //memcpy(&task_fbg->vinfo, &fbg->vinfo, sizeof(struct fb_var_screeninfo));
+    //memcpy(&task_fbg->finfo, &fbg->finfo, sizeof(struct fb_fix_screeninfo));
+
+    task_fbg->components = fbg->components;
+    task_fbg->comp_offset = fbg->comp_offset;
+    task_fbg->format = fbg->format;
+    task_fbg->bgr = fbg->bgr;
+    task_fbg->line_length = fbg->line_length;
+
+    task_fbg->simd = fbg->simd;
+    task_fbg->kernels = fbg->kernels;
+    task_fbg->primitives = fbg->primitives;
+
+    task_fbg->wait_spin = fbg->wait_spin;
+
+    task_fbg->dirty_tracking = fbg->dirty_tracking;
+    memset(&task_fbg->dirty, 0, sizeof(struct _fbg_bbox));
+
+    task_fbg->width = fbg->width;
+    task_fbg->height = fbg->height;
+
+    task_fbg->region = fbg->region;
+
+    task_fbg->parallel_tasks = fbg->parallel_tasks;
+
+    int shared = (fbg_fragmentSplit(fbg) != FBG_SPLIT_NONE);
+
+    int shared_offset = 0;
+    if (shared) {
+        shared_offset = fbg_fragmentRegion(fbg, task_fbg, index);
+    }
+
+    task_fbg->width_n_height = task_fbg->width * task_fbg->height;
+
+    task_fbg->size = task_fbg->width * task_fbg->height * task_fbg->components;
+
+    int buffers_count = 1;
+    int min_buffers_count = 1;
+    int buffers_size = 0;
+    if (!shared) {
+        // with FBG_DRAW_LATEST fbg_draw() keep the last buffer, fragments need more to draw into
+#ifdef FBG_LFDS
+        min_buffers_count = (fbg->draw_policy == FBG_DRAW_LATEST) ? 3 : 1;
+#else
+        min_buffers_count = (fbg->draw_policy == FBG_DRAW_LATEST) ? 2 : 1;
+#endif
+        buffers_count = _FBG_MAX((int)fbg->fragment_queue_size, min_buffers_count);
+        buffers_size = task_fbg->line_length * task_fbg->height;
+
+        // fragments get an equal share of the buffer pool limit
+        if (fbg->buffer_pool->limit) {
+            int pool_count = (int)(fbg->buffer_pool->limit / fbg_bufferClass(buffers_size) / fbg->parallel_tasks);
+
+            buffers_count = _FBG_MAX(_FBG_MIN(buffers_count, pool_count), min_buffers_count);
+        }
+    }
+
+    frag->buffer_pool = fbg->buffer_pool;
+
+    if (!fbg_resetFragmentBuffers(frag, buffers_count, buffers_size, shared)) {
+        fbg_freeFragmentBuffers(frag);
+
+        frag->clear_buffers = 0;
+
+        int buffers_allocated = 0;
+#ifdef FBG_LFDS
+        if (!shared) {
+            buffers_allocated = fbg_allocFragmentQueue(frag, buffers_count, min_buffers_count, buffers_size);
+        } else {
+            buffers_allocated = fbg_allocFragmentBuffers(frag, 1, 1, 0, 1);
+        }
+#else
+        buffers_allocated = fbg_allocFragmentBuffers(frag, buffers_count, min_buffers_count, buffers_size, shared);
+#endif
+
+        if (!buffers_allocated) {
+            fprintf(stderr, "fbg_setupFragment: frag buffers allocation failed!\n");
+
+            return 0;
+        }
+    }
+
+    // pooled fragments frames are completed together already
+    task_fbg->sync_barrier = (fbg->draw_policy == FBG_DRAW_LATEST || frag->pooled) ? NULL : fbg->sync_barrier;
+    task_fbg->task_id = index + 1;
+
+    frag->pool = fbg->pool;
+    task_fbg->pool = fbg->pool;
+
+    frag->shared_buffer = shared ? &fbg->back_buffer : NULL;
+    frag->shared_offset = shared_offset;
+
+    frag->mixing_buffer = NULL;
+    memset(&frag->mixing_frame, 0, sizeof(struct _fbg_frame_info));
+#ifdef FBG_LFDS
+    frag->tmp_fbg_freelist_data = NULL;
+    frag->mixing_data = NULL;
+#endif
+
+    atomic_store(&frag->frames, 0);
+    atomic_store(&frag->wait_time, 0);
+    atomic_store(&frag->wait_sleeps, 0);
+    atomic_store(&frag->draw_wait_time, 0);
+    atomic_store(&frag->draw_wait_sleeps, 0);
+    atomic_store(&frag->overwrites, 0);
+    atomic_store(&frag->drops, 0);
+    atomic_store(&frag->reuses, 0);
+    atomic_store(&frag->render_time, 0);
+
+    return 1;
+}
+
+// create the fragment of the given index and start its thread
+int fbg_spawnFragment(struct _fbg *fbg, int index,
+        void *(*user_fragment_start)(struct _fbg *fbg),
+        void (*user_fragment)(struct _fbg *fbg, void *user_data),
+        void (*user_fragment_stop)(struct _fbg *fbg, void *user_data)) {
+    // create a task fbg structure for each threads
+    struct _fbg *task_fbg = (struct _fbg *)calloc(1, sizeof(struct _fbg));
+    if (!task_fbg) {
+        fprintf(stderr, "fbg_spawnFragment: task_fbg calloc failed!\n");
+
+        return 0;
+    }
+
+    struct _fbg_fragment *frag = (struct _fbg_fragment *)calloc(1, sizeof(struct _fbg_fragment));
+    if (!frag) {
+        fprintf(stderr, "fbg_spawnFragment: frag calloc failed!\n");
+
+        free(task_fbg);
+
+        return 0;
+    }
+
+    frag->fbg = task_fbg;
+
+    // fragments of contexts sharing a pool are run by the pool threads (all fragments of a context run the same way)
+    frag->pooled = (index > 0) ? fbg->fragments[0]->pooled : fbg->pool->shared;
+
+    if (!fbg_setupFragment(fbg, frag, index)) {
+        free(task_fbg);
+        free(frag);
+
+        return 0;
+    }
+
+    frag->state = FBG_FRAGMENT_RUNNING;
+
+    frag->user_fragment_start = user_fragment_start;
+    frag->user_fragment = user_fragment;
+    frag->user_fragment_stop = user_fragment_stop;
+
+    fbg->fragments[index] = frag;
+
+    fbg->fragments_pooled = frag->pooled;
+
+    if (frag->pooled) {
+        // no workers : the frames are run serially by the thread calling fbg_draw()
+        if (index == 0 && fbg->pool->workers_count == 0) {
+            fprintf(stderr, "fbg_spawnFragment: pooled fragments without pool workers are run by the thread calling fbg_draw(), see fbg_createWorkers()!\n");
+        }
+
+        return 1;
+    }
+
+    pthread_attr_t attr;
+    fbg_initThreadAttr(fbg, &attr, index + 1);
+
+    int err = pthread_create(&fbg->tasks[index], &attr, (void * (*)(void *))fbg_fragment, frag);
+
+    pthread_attr_destroy(&attr);
+
+    if (err) {
+        fprintf(stderr, "fbg_spawnFragment: pthread_create error '%i'!\n", err);
+
+        fbg_freeFragmentBuffers(frag);
+        free(task_fbg);
+        free(frag);
+
+        return 0;
+    }
+
+    fbg_applyThreadSettings(fbg, fbg->tasks[index], index + 1, index);
+
+    return 1;
+}
+
+// park all fragments at the start of their loop and wait for them, their context and buffers can then be changed by the calling thread
+void fbg_parkFragments(struct _fbg *fbg) {
+    int i = 0;
+
+    if (fbg->fragments_pooled) {
+        // no threads : wait for the running frame
+        fbg_waitTaskGroup(fbg, &fbg->fragments_group);
+
+        for (i = 0; i < fbg->parallel_tasks; i += 1) {
+            atomic_store(&fbg->fragments[i]->state, FBG_FRAGMENT_PARKED);
+        }
+
+        return;
+    }
+
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        atomic_store(&fbg->fragments[i]->state, FBG_FRAGMENT_PARKED);
+
+        fbg_wakeFragment(fbg->fragments[i]);
+    }
+
+    if (fbg->sync_barrier) {
+        fbg_wakeSync(&fbg->sync_barrier->generation);
+    }
+
+    atomic_int running = FBG_FRAGMENT_RUNNING;
+
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        struct _fbg_fragment *frag = fbg->fragments[i];
+
+        fbg_waitSync(&frag->parked, 0, &running, frag->fbg->wait_spin, NULL, NULL, NULL);
+    }
+
+    // fragments may have left the barrier early
+    if (fbg->sync_barrier) {
+        atomic_store(&fbg->sync_barrier->arrived, 0);
+    }
+}
+
+// resume parked fragments
+void fbg_resumeFragments(struct _fbg *fbg) {
+    int i = 0;
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        atomic_store(&fbg->fragments[i]->state, FBG_FRAGMENT_RUNNING);
+
+        fbg_setSync(&fbg->fragments[i]->parked, 0);
+    }
+}
+
+// (re)configure fragments : existing ones are parked and reused, extra ones terminated and missing ones created, return the number of running fragments
+int fbg_configureFragments(struct _fbg *fbg,
+        void *(*user_fragment_start)(struct _fbg *fbg),
+        void (*user_fragment)(struct _fbg *fbg, void *user_data),
+        void (*user_fragment_stop)(struct _fbg *fbg, void *user_data),
+        int parallel_tasks, int restart) {
+    int i = 0;
+
+    fbg_parkFragments(fbg);
+
+    if (parallel_tasks < fbg->parallel_tasks) {
+        for (i = parallel_tasks; i < fbg->parallel_tasks; i += 1) {
+            fbg_terminateFragment(fbg->fragments[i]);
+        }
+
+        for (i = parallel_tasks; i < fbg->parallel_tasks; i += 1) {
+            fbg_freeFragment(fbg->tasks[i], fbg->fragments[i]);
+        }
+
+        fbg->parallel_tasks = parallel_tasks;
+    }
+
+    int reused_tasks = fbg->parallel_tasks;
+
+    pthread_t *tasks = (pthread_t *)realloc(fbg->tasks, sizeof(pthread_t) * parallel_tasks);
+    if (!tasks) {
+        fprintf(stderr, "fbg_configureFragments: tasks realloc failed!\n");
+
+        return 0;
+    }
+
+    fbg->tasks = tasks;
+
+    struct _fbg_fragment **fragments = (struct _fbg_fragment **)realloc(fbg->fragments, sizeof(struct _fbg_fragment *) * parallel_tasks);
+    if (!fragments) {
+        fprintf(stderr, "fbg_configureFragments: fragments realloc failed!\n");
+
+        return 0;
+    }
+
+    fbg->fragments = fragments;
+
+    if (!fbg->sync_barrier) {
+        fbg->sync_barrier = (struct _fbg_barrier *)calloc(1, sizeof(struct _fbg_barrier));
+        if (!fbg->sync_barrier) {
+            fprintf(stderr, "fbg_configureFragments: sync_barrier calloc failed!\n");
+
+            return 0;
+        }
+    }
+
+    fbg->sync_barrier->count = parallel_tasks;
+
+    // fragments contexts / split areas depend on the final count
+    fbg->parallel_tasks = parallel_tasks;
+
+    if (fbg->split_mode == FBG_SPLIT_PASSTHROUGH && parallel_tasks > 1) {
+        fprintf(stderr, "fbg_configureFragments: FBG_SPLIT_PASSTHROUGH is only used by a single fragment, %d fragments are mixed\n", parallel_tasks);
+    }
+
+    int configured_tasks = 0;
+    for (i = 0; i < reused_tasks; i += 1) {
+        struct _fbg_fragment *frag = fbg->fragments[i];
+
+        if (restart || frag->user_fragment_start != user_fragment_start || frag->user_fragment != user_fragment || frag->user_fragment_stop != user_fragment_stop) {
+            frag->restart = 1;
+        }
+
+        frag->user_fragment_start = user_fragment_start;
+        frag->user_fragment = user_fragment;
+        frag->user_fragment_stop = user_fragment_stop;
+
+        configured_tasks += fbg_setupFragment(fbg, frag, i);
+
+        if (!frag->pooled) {
+            fbg_applyThreadSettings(fbg, fbg->tasks[i], i + 1, i);
+        }
+    }
+
+    int created_tasks = reused_tasks;
+    for (i = reused_tasks; i < parallel_tasks; i += 1) {
+        if (!fbg_spawnFragment(fbg, i, user_fragment_start, user_fragment, user_fragment_stop)) {
+            break;
+        }
+
+        created_tasks += 1;
+        configured_tasks += 1;
+    }
+
+    fbg->parallel_tasks = created_tasks;
+
+    // fragments counters were reset
+    fbg_resetAdaptiveWindow(fbg);
+
+    // fragments are running again
+    fbg->idle.parked = 0;
+    fbg->idle.frames = 0;
+
+    // buffers given back over the limit
+    pthread_mutex_lock(&fbg->buffer_pool->mutex);
+    fbg_trimBuffers(fbg->buffer_pool, 1);
+    pthread_mutex_unlock(&fbg->buffer_pool->mutex);
+
+    // fragments without buffers must stay parked till terminated
+    if (configured_tasks != parallel_tasks) {
+        return configured_tasks;
+    }
+
+    for (i = 0; i < reused_tasks; i += 1) {
+        atomic_store(&fbg->fragments[i]->state, FBG_FRAGMENT_RUNNING);
+
+        fbg_setSync(&fbg->fragments[i]->parked, 0);
+    }
+
+    return configured_tasks;
+}
+
+void fbg_updateFragments(struct _fbg *fbg,
+        void *(*user_fragment_start)(struct _fbg *fbg),
+        void (*user_fragment)(struct _fbg *fbg, void *user_data),
+        void (*user_fragment_stop)(struct _fbg *fbg, void *user_data),
+        unsigned int parallel_tasks, int restart) {
+    if (parallel_tasks < 1) {
+        return;
+    }
+
+    if (fbg_configureFragments(fbg, user_fragment_start, user_fragment, user_fragment_stop, (int)parallel_tasks, restart) != (int)parallel_tasks) {
+        fprintf(stderr, "fbg_updateFragments: Some of the specified number of tasks failed to initialize, as such no tasks were created.\n");
+
+        fbg_terminateFragments(fbg);
+
+        fbg_freeTasks(fbg);
+    }
+}
+
+void fbg_createFragment(struct _fbg *fbg,
+        void *(*user_fragment_start)(struct _fbg *fbg),
+        void (*user_fragment)(struct _fbg *fbg, void *user_data),
+        void (*user_fragment_stop)(struct _fbg *fbg, void *user_data),
+        unsigned int parallel_tasks) {
+    fbg_updateFragments(fbg, user_fragment_start, user_fragment, user_fragment_stop, parallel_tasks, 1);
+}
+
+void fbg_reconfigureFragments(struct _fbg *fbg,
+        void *(*user_fragment_start)(struct _fbg *fbg),
+        void (*user_fragment)(struct _fbg *fbg, void *user_data),
+        void (*user_fragment_stop)(struct _fbg *fbg, void *user_data),
+        unsigned int parallel_tasks) {
+    fbg_updateFragments(fbg, user_fragment_start, user_fragment, user_fragment_stop, parallel_tasks, 0);
+}
+#endif
+
+void fbg_fill(struct _fbg *fbg, unsigned char r, unsigned char g, unsigned char b) {
+    _FBG_NATIVE_RGB(fbg, r, b);
+
+    fbg->fill_color.r = r;
+    fbg->fill_color.g = g;
+    fbg->fill_color.b = b;
+}
+
+void fbg_polygon(struct _fbg *fbg, int num_vertices, int *vertices, unsigned char r, unsigned char g, unsigned char b) {
+    int i;
+
+    for (i = 0; i < num_vertices - 1; i += 1) {
+        fbg_line(fbg, vertices[(i << 1) + 0],
+            vertices[(i << 1) + 1],
+            vertices[(i << 1) + 2],
+            vertices[(i << 1) + 3],
+            r, g, b);
+    }
+
+    fbg_line(fbg, vertices[0],
+         vertices[1],
+         vertices[(num_vertices << 1) - 2],
+         vertices[(num_vertices << 1) - 1],
+         r, g, b);
+}
+
+void fbg_frect(struct _fbg *fbg, int x, int y, int w, int h) {
+    fbg_dirty(fbg, x, y, w, h);
+
+    int xx, yy, w3 = w * fbg->components;
+
+    char *fpix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
+
+    char *org_pointer = fpix_pointer;
+    char *pix_pointer = fpix_pointer;
+
+    for (xx = 0; xx < w; xx += 1) {
+        *pix_pointer++ = fbg->fill_color.r;
+        *pix_pointer++ = fbg->fill_color.g;
+        *pix_pointer++ = fbg->fill_color.b;
+
+        if (fbg->comp_offset) {
+            *pix_pointer++ = 0;
+        }
+    }
+
+    for (yy = 1; yy < h; yy += 1) {
+        fpix_pointer += fbg->line_length;
+
+        memcpy(fpix_pointer, org_pointer, w3);
+    }
+}
+
+void fbg_getPixel(struct _fbg *fbg, int x, int y, struct _fbg_rgb *color) {
+    int ofs = y * fbg->line_length + x * fbg->components;
+
+    memcpy(color, (char *)(fbg->back_buffer + ofs), fbg->components);
+
+    _FBG_NATIVE_RGB(fbg, color->r, color->b);
+}
+
+// allocate the dirty tiles bitmaps of a display (single block), the first frame is presented whole
+struct _fbg_tiles *fbg_allocTiles(int width, int height) {
+    int tiles_x = (width + FBG_TILE_SIZE - 1) / FBG_TILE_SIZE;
+    int tiles_y = (height + FBG_TILE_SIZE - 1) / FBG_TILE_SIZE;
+    int row_words = (tiles_x + 31) / 32;
+
+    size_t bitmap_size = (size_t)row_words * tiles_y * sizeof(uint32_t);
+    size_t rects_size = (size_t)tiles_x * tiles_y * sizeof(struct _fbg_bbox);
+
+    unsigned char *block = (unsigned char *)calloc(1, sizeof(struct _fbg_tiles) + bitmap_size * 3 + rects_size + tiles_x * 2 * sizeof(int));
+    if (!block) {
+        fprintf(stderr, "fbg_allocTiles: tiles calloc failed!\n");
+
+        return NULL;
+    }
+
+    struct _fbg_tiles *tiles = (struct _fbg_tiles *)block;
+    block += sizeof(struct _fbg_tiles);
+
+    tiles->touched = (uint32_t *)block;
+    tiles->presented = (uint32_t *)(block + bitmap_size);
+    tiles->pending = (uint32_t *)(block + bitmap_size * 2);
+    tiles->rects = (struct _fbg_bbox *)(block + bitmap_size * 3);
+    tiles->active = (int *)(block + bitmap_size * 3 + rects_size);
+
+    tiles->tiles_x = tiles_x;
+    tiles->tiles_y = tiles_y;
+    tiles->row_words = row_words;
+    tiles->full = 1;
+
+    return tiles;
+}
+
+// mark the tiles of an area (clipped, x2 / y2 excluded) as touched
+void fbg_markTiles(struct _fbg_tiles *tiles, int x1, int y1, int x2, int y2) {
+    int tx1 = x1 / FBG_TILE_SIZE;
+    int tx2 = (x2 - 1) / FBG_TILE_SIZE;
+
+    int first_word = tx1 >> 5;
+    int last_word = tx2 >> 5;
+    uint32_t first_mask = 0xffffffffu << (tx1 & 31);
+    uint32_t last_mask = 0xffffffffu >> (31 - (tx2 & 31));
+
+    int ty = 0, w = 0;
+    for (ty = y1 / FBG_TILE_SIZE; ty <= (y2 - 1) / FBG_TILE_SIZE; ty += 1) {
+        uint32_t *row = tiles->touched + ty * tiles->row_words;
+
+        if (first_word == last_word) {
+            row[first_word] |= first_mask & last_mask;
+
+            continue;
+        }
+
+        row[first_word] |= first_mask;
+
+        for (w = first_word + 1; w < last_word; w += 1) {
+            row[w] = 0xffffffffu;
+        }
+
+        row[last_word] |= last_mask;
+    }
+}
+
+// a frame is presented : the display changed where it or the previous presented frame touched tiles
+void fbg_presentTiles(struct _fbg_tiles *tiles) {
+    int i = 0;
+    for (i = 0; i < tiles->row_words * tiles->tiles_y; i += 1) {
+        tiles->pending[i] |= tiles->touched[i] | tiles->presented[i];
+        tiles->presented[i] = tiles->touched[i];
+    }
+}
+
+// hash the back buffer tiles, return the number of tiles which differ from the presented frame (all of them when it was not hashed yet), the hashes then become the presented frame ones
+int fbg_hashTiles(struct _fbg *fbg) {
+    struct _fbg_idle *idle = &fbg->idle;
+
+    int tiles_x = (fbg->width + FBG_TILE_SIZE - 1) / FBG_TILE_SIZE;
+    int tiles_y = (fbg->height + FBG_TILE_SIZE - 1) / FBG_TILE_SIZE;
+    int tiles_count = tiles_x * tiles_y;
+
+    if (!idle->tiles_hash || idle->tiles_x != tiles_x || idle->tiles_y != tiles_y) {
+        free(idle->tiles_hash);
+
+        // presented frame hashes then back buffer hashes
+        idle->tiles_hash = (uint64_t *)calloc(tiles_count * 2, sizeof(uint64_t));
+        if (!idle->tiles_hash) {
+            fprintf(stderr, "fbg_hashTiles: tiles_hash calloc failed!\n");
+
+            idle->tiles_x = 0;
+            idle->tiles_y = 0;
+
+            return 1;
+        }
+
+        idle->tiles_x = tiles_x;
+        idle->tiles_y = tiles_y;
+        idle->hashed = 0;
+    }
+
+    uint64_t *hash = idle->tiles_hash + tiles_count;
+
+    int x = 0, y = 0, i = 0;
+    for (i = 0; i < tiles_count; i += 1) {
+        hash[i] = 0xcbf29ce484222325ULL;
+    }
+
+    // row by row so that the buffer is read sequentially, each row segment is folded into its tile hash (FNV-1a on 64 bits words)
+    int tile_length = FBG_TILE_SIZE * fbg->components;
+    for (y = 0; y < fbg->height; y += 1) {
+        unsigned char *row = fbg->back_buffer + y * fbg->line_length;
+        uint64_t *row_hash = hash + (y / FBG_TILE_SIZE) * tiles_x;
+
+        for (x = 0; x < tiles_x; x += 1) {
+            unsigned char *segment = row + x * tile_length;
+            int length = _FBG_MIN(tile_length, fbg->width * fbg->components - x * tile_length);
+
+            uint64_t h = row_hash[x];
+
+            for (i = 0; i + 8 <= length; i += 8) {
+                uint64_t word;
+                memcpy(&word, segment + i, 8);
+
+                h = (h ^ word) * 0x100000001b3ULL;
+            }
+
+            for (; i < length; i += 1) {
+                h = (h ^ segment[i]) * 0x100000001b3ULL;
+            }
+
+            row_hash[x] = h;
+        }
+    }
+
+    int changed_tiles = 0;
+    for (i = 0; i < tiles_count; i += 1) {
+        if (!idle->hashed || hash[i] != idle->tiles_hash[i]) {
+            changed_tiles += 1;
+        }
+    }
 
-            unsigned char *disp_buffer = calloc(1, new_size * sizeof(char));
-            if (!disp_buffer) {
-                fprintf(stderr, "fbg_resize: disp_buffer realloc failed!\n");
+    memcpy(idle->tiles_hash, hash, tiles_count * sizeof(uint64_t));
 
-                free(back_buffer);
+    idle->hashed = 1;
 
-                return;
-            }
+    return changed_tiles;
+}
 
-#ifdef FBG_PARALLEL
-            if (fbg->tasks) {
-                parallel_tasks = fbg->parallel_tasks;
+// called by fbg_flip(), return 1 when the frame must be presented, count unchanged frames otherwise (see fbg_setIdleDetection())
+int fbg_idleFrame(struct _fbg *fbg) {
+    struct _fbg_idle *idle = &fbg->idle;
 
-                // save user fragments function to restore them later
-                user_fragment_start = fbg->fragments[0]->user_fragment_start;
-                user_fragment = fbg->fragments[0]->user_fragment;
-                user_fragment_stop = fbg->fragments[0]->user_fragment_stop;
+    int unchanged = idle->skip;
 
-                fbg_terminateFragments(fbg);
-                
-                fbg_freeTasks(fbg);
+    if (!unchanged && (idle->mode & FBG_IDLE_HASH) && fbg->back_buffer) {
+        if (idle->parked) {
+            // parked : nothing is mixed so the back buffer is compared with the first parked frame (hashes were reset when parking), a change come from the calling thread
+            int baseline = !idle->hashed;
 
-                create_fragments = 1;
+            if (fbg_hashTiles(fbg) > 0 && !baseline) {
+                fbg_wake(fbg);
+
+                // this frame lack the fragments content, the next one is presented in full
+                idle->hashed = 0;
             }
-#endif
 
-            unsigned char *old_back_buffer = fbg->back_buffer;
-            unsigned char *old_disp_buffer = fbg->disp_buffer;
+            unchanged = 1;
+        } else {
+            unchanged = (fbg_hashTiles(fbg) == 0);
+        }
+    } else if (idle->parked) {
+        unchanged = 1;
+    }
+
+    idle->skip = 0;
+    idle->unchanged = 0;
+
+    if (!unchanged) {
+        uint64_t now = fbg_timeNs();
 
-            fbg->back_buffer = back_buffer;
-            fbg->disp_buffer = disp_buffer;
+        // interval between consecutive presented frames (throttled by the backend : vertical sync etc.)
+        if (idle->presented && idle->presented_time > 0) {
+            uint64_t frame_time = now - idle->presented_time;
 
-            free(old_back_buffer);
-            free(old_disp_buffer);
+            idle->frame_time = idle->frame_time ? (idle->frame_time * 3 + frame_time) / 4 : frame_time;
         }
 
-        fbg->width = new_width;
-        fbg->height = new_height;
+        idle->presented_time = now;
+        idle->next_frame = now;
+        idle->frames = 0;
 
-        fbg->line_length = fbg->width * fbg->components;
+        return 1;
+    }
 
-        fbg->width_n_height = fbg->width * fbg->height;
+    idle->frames += 1;
+    idle->skipped += 1;
 
-        fbg->size = new_size;
+    return 0;
+}
 
-        if (fbg->user_resize) {
-            fbg->user_resize(fbg, new_width, new_height);
-        }
+// sleep till the next unchanged frame is due, they are not throttled by the backend (no vertical sync wait / buffers swap) so they keep the rate of the presented frames instead
+void fbg_paceIdleFrame(struct _fbg *fbg) {
+    struct _fbg_idle *idle = &fbg->idle;
 
-#ifdef FBG_PARALLEL
-        if (fbg->tasks || create_fragments) {
-            if (!user_fragment_start) {
-                user_fragment_start = fbg->fragments[0]->user_fragment_start;
-            }
+    uint64_t frame_time = idle->frame_time ? idle->frame_time : FBG_IDLE_FRAME_TIME;
+    uint64_t now = fbg_timeNs();
 
-            if (!user_fragment) {
-                user_fragment = fbg->fragments[0]->user_fragment;
-            }
+    // late by more than a frame : start again from now instead of catching up
+    if (now > idle->next_frame + frame_time) {
+        idle->next_frame = now;
+    }
 
-            if (!user_fragment_stop) {
-                user_fragment_stop = fbg->fragments[0]->user_fragment_stop;
-            }
+    idle->next_frame += frame_time;
 
-            fbg_createFragment(fbg, user_fragment_start, user_fragment, user_fragment_stop, parallel_tasks);
-        }
-#endif
-    } else {
-        if (fbg->user_resize) {
-            fbg->user_resize(fbg, new_width, new_height);
-        }
+    if (idle->next_frame > now) {
+        struct timespec t;
+        t.tv_sec = idle->next_frame / 1000000000ull;
+        t.tv_nsec = idle->next_frame % 1000000000ull;
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR);
     }
 }
 
-void fbg_pushResize(struct _fbg *fbg, int new_width, int new_height) {
-    if (new_width > 0 && new_height > 0) {
-        fbg->new_width = new_width;
-        fbg->new_height = new_height;
+#ifdef FBG_PARALLEL
+struct _fbg_mixing *fbg_getMixing(struct _fbg *fbg, int task_id) {
+    static struct _fbg_mixing default_mixing = { FBG_MIXING_ADDITIVE, 255, { 0, 0, 0, 0 } };
+
+    if (task_id < 0 || task_id >= fbg->mixing_count) {
+        return &default_mixing;
     }
+
+    return &fbg->mixing[task_id];
 }
 
-#ifdef FBG_PARALLEL
-// basically tell all threads/fragments that they should stop
-void fbg_terminateFragments(struct _fbg *fbg) {
-    int i = 0;
-    for (i = 0; i < fbg->parallel_tasks; i += 1) {
-        struct _fbg_fragment *frag = fbg->fragments[i];
+struct _fbg_mixing *fbg_allocMixing(struct _fbg *fbg, int task_id) {
+    if (task_id < 0) {
+        return NULL;
+    }
+
+    if (task_id >= fbg->mixing_count) {
+        struct _fbg_mixing *mixing = (struct _fbg_mixing *)realloc(fbg->mixing, sizeof(struct _fbg_mixing) * (task_id + 1));
+        if (!mixing) {
+            fprintf(stderr, "fbg_allocMixing: mixing realloc failed!\n");
+
+            return NULL;
+        }
+
+        int i = 0;
+        for (i = fbg->mixing_count; i <= task_id; i += 1) {
+            mixing[i] = *fbg_getMixing(fbg, -1);
+        }
 
-        frag->state = 0;
+        fbg->mixing = mixing;
+        fbg->mixing_count = task_id + 1;
     }
+
+    return &fbg->mixing[task_id];
 }
 
-#ifdef FBG_LFDS
-void fbg_clearQueue(struct lfds720_ringbuffer_n_state *rs, struct lfds720_freelist_n_state *fs) {
-    void *key;
-    struct _fbg_freelist_data *freelist_data;
-    while (lfds720_ringbuffer_n_read(rs, &key, NULL)) {
-        freelist_data = (struct _fbg_freelist_data *)key;
-
-        LFDS720_FREELIST_N_SET_VALUE_IN_ELEMENT(freelist_data->freelist_element, freelist_data);
-#ifdef LFDS711
-        lfds720_freelist_n_threadsafe_push(fs, &freelist_data->freelist_element, NULL);
-#else
-        lfds720_freelist_n_threadsafe_push(fs, NULL, &freelist_data->freelist_element);
-#endif
+void fbg_setMixing(struct _fbg *fbg, int task_id, enum _fbg_mixing_mode mode, int alpha) {
+    struct _fbg_mixing *mixing = fbg_allocMixing(fbg, task_id);
+    if (!mixing) {
+        return;
     }
+
+    mixing->mode = mode;
+    mixing->alpha = _FBG_MAX(_FBG_MIN(alpha, 255), 0);
 }
-#endif
 
-void fbg_freeTasks(struct _fbg *fbg) {
-    int i = 0;
-    for (i = 0; i < fbg->parallel_tasks; i += 1) {
-        pthread_join(fbg->tasks[i], NULL);
+void fbg_setMixingColorkey(struct _fbg *fbg, int task_id, unsigned char r, unsigned char g, unsigned char b) {
+    struct _fbg_mixing *mixing = fbg_allocMixing(fbg, task_id);
+    if (!mixing) {
+        return;
+    }
 
-        struct _fbg_fragment *frag = fbg->fragments[i];
+    _FBG_NATIVE_RGB(fbg, r, b);
 
-#ifndef FBG_LFDS
-        free(frag->fbg->back_buffer);
-#endif
-        free(frag->fbg);
+    mixing->colorkey.r = r;
+    mixing->colorkey.g = g;
+    mixing->colorkey.b = b;
+}
 
-#ifdef FBG_LFDS
-        fbg_clearQueue(frag->ringbuffer_state, frag->freelist_state);
+// rows of a mixing : a single run over the buffer unless rows are padded or the context is narrower (fbg_mixFragment), return the number of rows and their length in bytes
+int fbg_mixingRows(struct _fbg *fbg, int *length) {
+    int row_length = fbg->width * fbg->components;
 
-        lfds720_ringbuffer_n_cleanup(frag->ringbuffer_state, fbg_ringbufferCleanup);
-        lfds720_freelist_n_cleanup(frag->freelist_state, fbg_freelistCleanup);
-        free(frag->ringbuffer_element);
-        free(frag->ringbuffer_state);
-        free(frag->freelist_state);
-        free(frag->fbg_freelist_data);
-#endif
+    if (row_length == fbg->line_length) {
+        *length = row_length * fbg->height;
 
-        free(frag);
+        return 1;
     }
 
-    if (fbg->parallel_tasks > 0) {
-        pthread_barrier_destroy(fbg->sync_barrier);
+    *length = row_length;
+
+    return fbg->height;
+}
 
-        free(fbg->sync_barrier);
+void fbg_additiveMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    int length = 0, rows = fbg_mixingRows(fbg, &length), y = 0;
 
-        fbg->sync_barrier = NULL;
+    for (y = 0; y < rows; y += 1) {
+        fbg->kernels.additive(fbg->back_buffer + y * fbg->line_length, buffer + y * fbg->line_length, length);
     }
+}
 
-    free(fbg->tasks);
-    free(fbg->fragments);
+void fbg_alphaMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    int alpha = fbg_getMixing(fbg, task_id)->alpha;
 
-    fbg->tasks = NULL;
-    fbg->fragments = NULL;
+    int length = 0, rows = fbg_mixingRows(fbg, &length), y = 0;
 
-    fbg->parallel_tasks = 0;
+    for (y = 0; y < rows; y += 1) {
+        fbg->kernels.alpha(fbg->back_buffer + y * fbg->line_length, buffer + y * fbg->line_length, length, alpha);
+    }
 }
-#endif
 
-void fbg_close(struct _fbg *fbg) {
-#ifdef FBG_PARALLEL
-    fbg_terminateFragments(fbg);
+void fbg_alphaColorkeyMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    struct _fbg_mixing *mixing = fbg_getMixing(fbg, task_id);
 
-    fbg_freeTasks(fbg);
-#endif
+    int length = 0, rows = fbg_mixingRows(fbg, &length), y = 0;
 
-    if (fbg->user_free) {
-        fbg->user_free(fbg);
+    for (y = 0; y < rows; y += 1) {
+        fbg->kernels.alphaColorkey(fbg->back_buffer + y * fbg->line_length, buffer + y * fbg->line_length, length, fbg->components, mixing->colorkey, mixing->alpha);
     }
+}
 
-    if (fbg->initialize_buffers) {
-        free(fbg->back_buffer);
-        free(fbg->disp_buffer);
-    }
+void fbg_maxMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    int length = 0, rows = fbg_mixingRows(fbg, &length), y = 0;
 
-    free(fbg);
+    for (y = 0; y < rows; y += 1) {
+        fbg->kernels.max(fbg->back_buffer + y * fbg->line_length, buffer + y * fbg->line_length, length);
+    }
 }
 
-void fbg_computeFramerate(struct _fbg *fbg, int to_string) {
-    gettimeofday(&fbg->fps_stop, NULL);
+void fbg_multiplyMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    int length = 0, rows = fbg_mixingRows(fbg, &length), y = 0;
 
-    double ms = (fbg->fps_stop.tv_sec - fbg->fps_start.tv_sec) * 1000000.0 - (fbg->fps_stop.tv_usec - fbg->fps_start.tv_usec);
-    if (ms >= 1000.0) {
-        gettimeofday(&fbg->fps_start, NULL);
+    for (y = 0; y < rows; y += 1) {
+        fbg->kernels.multiply(fbg->back_buffer + y * fbg->line_length, buffer + y * fbg->line_length, length);
+    }
+}
 
-#ifdef FBG_PARALLEL
-        atomic_exchange_explicit(&fbg->fps, fbg->frame, memory_order_relaxed);
-#else
-        fbg->fps = fbg->frame;
-#endif
-        fbg->frame = 0;
+void fbg_screenMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    int length = 0, rows = fbg_mixingRows(fbg, &length), y = 0;
 
-        if (to_string) {
-            sprintf(fbg->fps_char, "%lu", (long unsigned int)fbg->fps);
-        }
+    for (y = 0; y < rows; y += 1) {
+        fbg->kernels.screen(fbg->back_buffer + y * fbg->line_length, buffer + y * fbg->line_length, length);
     }
+}
 
-    fbg->frame += 1;
+void fbg_colorkeyMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    struct _fbg_rgb colorkey = fbg_getMixing(fbg, task_id)->colorkey;
+
+    int length = 0, rows = fbg_mixingRows(fbg, &length), y = 0;
+
+    for (y = 0; y < rows; y += 1) {
+        fbg->kernels.colorkey(fbg->back_buffer + y * fbg->line_length, buffer + y * fbg->line_length, length, fbg->components, colorkey);
+    }
 }
 
+void fbg_copyMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    int length = 0, rows = fbg_mixingRows(fbg, &length), y = 0;
 
-void fbg_drawFramerate(struct _fbg *fbg, struct _fbg_font *fnt, int task, int x, int y, int r, int g, int b) {
-#ifdef FBG_PARALLEL
-    if (task > fbg->parallel_tasks) {
-        return;
+    for (y = 0; y < rows; y += 1) {
+        memcpy(fbg->back_buffer + y * fbg->line_length, buffer + y * fbg->line_length, length);
     }
-#endif
+}
 
-    if (!fnt) {
-        fnt = &fbg->current_font;
+void fbg_taskMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
+    switch (fbg_getMixing(fbg, task_id)->mode) {
+        case FBG_MIXING_ALPHA:
+            fbg_alphaMixing(fbg, buffer, task_id);
+            break;
+        case FBG_MIXING_ALPHA_COLORKEY:
+            fbg_alphaColorkeyMixing(fbg, buffer, task_id);
+            break;
+        case FBG_MIXING_MAX:
+            fbg_maxMixing(fbg, buffer, task_id);
+            break;
+        case FBG_MIXING_MULTIPLY:
+            fbg_multiplyMixing(fbg, buffer, task_id);
+            break;
+        case FBG_MIXING_SCREEN:
+            fbg_screenMixing(fbg, buffer, task_id);
+            break;
+        case FBG_MIXING_COLORKEY:
+            fbg_colorkeyMixing(fbg, buffer, task_id);
+            break;
+        case FBG_MIXING_COPY:
+            fbg_copyMixing(fbg, buffer, task_id);
+            break;
+        default:
+            fbg_additiveMixing(fbg, buffer, task_id);
     }
+}
 
-#ifdef FBG_PARALLEL
-    if (task > 0) {
-        task -= 1;
+void fbg_setMixingStripes(struct _fbg *fbg, int stripes) {
+    fbg->mixing_stripes = _FBG_MAX(stripes, 0);
+}
 
-        static char fps_char[10];
+// wait for a fragment buffer to be available
+void fbg_acquireFragmentBuffer(struct _fbg_fragment *fragment) {
+    if (fragment->sync_wait) {
+        int index = fragment->read_index;
 
-        atomic_uint_fast16_t fps = atomic_load_explicit(&fbg->fragments[task]->fbg->fps, memory_order_relaxed);
+        fbg_waitSync(&fragment->sync_wait[index], 0, &fragment->state, fragment->fbg->wait_spin, NULL, &fragment->draw_wait_time, &fragment->draw_wait_sleeps);
 
-        sprintf(fps_char, "%i", (int)fps);
+        fragment->mixing_frame = fragment->buffers_frame[index];
 
-        fbg_text(fbg, fnt, fps_char, x, y, r, g, b);
+        if (fragment->buffers) {
+            fragment->mixing_buffer = fragment->buffers[index];
+        } else {
+            fragment->mixing_buffer = *fragment->shared_buffer + fragment->shared_offset;
+        }
 
         return;
     }
-#endif
 
-    fbg_text(fbg, fnt, fbg->fps_char, x, y, r, g, b);
-}
+#ifdef FBG_LFDS
+    struct _fbg_ringbuffer *ringbuffer = fragment->ringbuffer;
+    struct _fbg_freelist_data *freelist_data = NULL;
 
-int fbg_getFramerate(struct _fbg *fbg, int task) {
-#ifdef FBG_PARALLEL
-    if (task > fbg->parallel_tasks) {
-        return -1;
-    }
+    while (atomic_load(&fragment->state)) {
+        int written = atomic_load(&ringbuffer->written.value);
 
-    if (task > 0) {
-        task -= 1;
+        freelist_data = fbg_ringbufferRead(ringbuffer);
+        if (freelist_data) {
+            break;
+        }
 
-        atomic_uint_fast16_t fps = atomic_load_explicit(&fbg->fragments[task]->fbg->fps, memory_order_relaxed);
+        fbg_waitSync(&ringbuffer->written, written, &fragment->state, fragment->fbg->wait_spin, NULL, &fragment->draw_wait_time, &fragment->draw_wait_sleeps);
+    }
 
-        return (int)fps;
+    fragment->mixing_data = freelist_data;
+    fragment->mixing_buffer = freelist_data ? freelist_data->buffer : NULL;
+
+    if (freelist_data) {
+        fragment->mixing_frame = freelist_data->frame;
     }
 #endif
-
-    return fbg->fps;
 }
 
-#ifdef FBG_PARALLEL
-atomic_int fbg_fragmentState(struct _fbg_fragment *fbg_fragment) {
-    return fbg_fragment->state;
-}
+// give back the fragment buffer once mixed
+void fbg_releaseFragmentBuffer(struct _fbg_fragment *fragment) {
+    fragment->mixing_buffer = NULL;
 
-void fbg_fragmentPull(struct _fbg_fragment *fbg_fragment) {
-#ifdef FBG_LFDS
-    struct lfds720_freelist_n_element *freelist_element;
+    if (fragment->sync_wait) {
+        int index = fragment->read_index;
 
-#ifdef LFDS711
-    int pop_result = lfds720_freelist_n_threadsafe_pop(fbg_fragment->freelist_state, &freelist_element, NULL);
-#else
-    int pop_result = lfds720_freelist_n_threadsafe_pop(fbg_fragment->freelist_state, NULL, &freelist_element);
-#endif
+        fragment->read_index = (index + 1) % fragment->buffers_count;
 
-    if (pop_result == 0) {
-        fbg_fragment->fbg->back_buffer = NULL;
+        fbg_setSync(&fragment->sync_wait[index], 0);
 
         return;
     }
 
-    fbg_fragment->tmp_fbg_freelist_data = LFDS720_FREELIST_N_GET_VALUE_FROM_ELEMENT(*freelist_element);
+#ifdef FBG_LFDS
+    if (fragment->mixing_data) {
+        fbg_freelistPush(fragment, fragment->mixing_data);
 
-    fbg_fragment->fbg->back_buffer = fbg_fragment->tmp_fbg_freelist_data->buffer;
+        fragment->mixing_data = NULL;
+    }
 #endif
 }
 
-void fbg_fragmentPush(struct _fbg_fragment *fbg_fragment) {
+// drop the fragment buffer being mixed for its next one (wait for it)
+void fbg_dropFragmentBuffer(struct _fbg_fragment *fragment) {
+    atomic_fetch_add_explicit(&fragment->drops, 1, memory_order_relaxed);
+
+    fbg_releaseFragmentBuffer(fragment);
+    fbg_acquireFragmentBuffer(fragment);
+}
+
+// take the next fragment buffer if it is ready (the buffer being mixed is given back), return 0 otherwise
+int fbg_nextFragmentBuffer(struct _fbg_fragment *fragment) {
+    if (fragment->sync_wait) {
+        int index = fragment->read_index;
+
+        if (fragment->mixing_buffer) {
+            if (fragment->buffers_count < 2) {
+                return 0;
+            }
+
+            index = (index + 1) % fragment->buffers_count;
+        }
+
+        if (atomic_load(&fragment->sync_wait[index].value) != 1) {
+            return 0;
+        }
+
+        if (fragment->mixing_buffer) {
+            fbg_releaseFragmentBuffer(fragment);
+        }
+
+        fbg_acquireFragmentBuffer(fragment);
+
+        return 1;
+    }
+
 #ifdef FBG_LFDS
-    enum lfds720_misc_flag overwrite_occurred_flag;
+    struct _fbg_freelist_data *freelist_data = fbg_ringbufferRead(fragment->ringbuffer);
+    if (!freelist_data) {
+        return 0;
+    }
 
-    struct _fbg_freelist_data *overwritten_data = NULL;
-    lfds720_ringbuffer_n_write(fbg_fragment->ringbuffer_state, (void *) (lfds720_pal_uint_t) fbg_fragment->tmp_fbg_freelist_data, NULL, &overwrite_occurred_flag, (void *)&overwritten_data, NULL);
-    if (overwrite_occurred_flag == LFDS720_MISC_FLAG_RAISED) {
-#ifdef DEBUG
-        fprintf(stderr, "fbg_fragmentPush: Overwrite occured.\n");
-        fflush(stdout);
-#endif
+    if (fragment->mixing_data) {
+        fbg_freelistPush(fragment, fragment->mixing_data);
+    }
 
-        // okay, push it back!
-        LFDS720_FREELIST_N_SET_VALUE_IN_ELEMENT(overwritten_data->freelist_element, overwritten_data);
+    fragment->mixing_data = freelist_data;
+    fragment->mixing_buffer = freelist_data->buffer;
+    fragment->mixing_frame = freelist_data->frame;
 
-#ifdef LFDS711
-        lfds720_freelist_n_threadsafe_push(fbg_fragment->freelist_state, &overwritten_data->freelist_element, NULL);
+    return 1;
 #else
-        lfds720_freelist_n_threadsafe_push(fbg_fragment->freelist_state, NULL, &overwritten_data->freelist_element);
-#endif
-    }
+    return 0;
 #endif
 }
 
-void fbg_fragment(struct _fbg_fragment *fbg_fragment) {
-#ifdef FBG_LFDS
-    LFDS720_MISC_MAKE_VALID_ON_CURRENT_LOGICAL_CORE_INITS_COMPLETED_BEFORE_NOW_ON_ANY_OTHER_PHYSICAL_CORE;
-#endif
+// acquire a buffer of all fragments according to the draw policy
+void fbg_acquireFragmentBuffers(struct _fbg *fbg) {
+    int i = 0;
 
-    struct _fbg *fbg = fbg_fragment->fbg;
+    if (fbg->draw_policy == FBG_DRAW_LATEST && !fbg->fragments[0]->shared_buffer) {
+        // never wait : take the most recent completed buffer, keep mixing the last one if there is none
+        for (i = 0; i < fbg->parallel_tasks; i += 1) {
+            struct _fbg_fragment *fragment = fbg->fragments[i];
 
-    //fprintf(stdout, "fbg_fragment: Task started\n");
+            int updated = 0;
+            while (fbg_nextFragmentBuffer(fragment)) {
+                if (updated) {
+                    atomic_fetch_add_explicit(&fragment->drops, 1, memory_order_relaxed);
+                }
 
-    if (fbg_fragment->user_fragment_start) {
-        fbg_fragment->user_data = fbg_fragment->user_fragment_start(fbg);
-    } else {
-        fbg_fragment->user_data = NULL;
+                updated = 1;
+            }
+
+            if (!updated && fragment->mixing_buffer) {
+                atomic_fetch_add_explicit(&fragment->reuses, 1, memory_order_relaxed);
+
+                // same buffer mixed again
+                fragment->mixing_frame.unchanged = 1;
+            }
+        }
+
+        return;
     }
 
-    while (fbg_fragment->state) {
-        fbg_fragmentPull(fbg_fragment);
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        struct _fbg_fragment *fragment = fbg->fragments[i];
 
-        if (fbg->back_buffer) {
-            // execute user fragment
-            fbg_fragment->user_fragment(fbg, fbg_fragment->user_data);
+        // buffer kept by FBG_DRAW_LATEST
+        if (fragment->mixing_buffer && !fragment->shared_buffer) {
+            fbg_releaseFragmentBuffer(fragment);
+        }
+
+        fbg_acquireFragmentBuffer(fragment);
+    }
 
-            // wait till all fragments are completed
-            pthread_barrier_wait(fbg->sync_barrier);
+    if (fbg->draw_policy == FBG_DRAW_NEWEST) {
+        for (i = 0; i < fbg->parallel_tasks; i += 1) {
+            while (fbg_nextFragmentBuffer(fbg->fragments[i])) {
+                atomic_fetch_add_explicit(&fbg->fragments[i]->drops, 1, memory_order_relaxed);
+            }
+        }
+    } else if (fbg->draw_policy == FBG_DRAW_MATCHING) {
+        // catch up with the most recent sequence number till all fragments agree on it (fragments may have overwritten it)
+        int matching = 0;
+        while (!matching) {
+            uint64_t sequence = 0;
+            for (i = 0; i < fbg->parallel_tasks; i += 1) {
+                sequence = _FBG_MAX(sequence, fbg->fragments[i]->mixing_frame.sequence);
+            }
 
-            // push to main thread
-            fbg_fragmentPush(fbg_fragment);
+            matching = 1;
+            for (i = 0; i < fbg->parallel_tasks; i += 1) {
+                struct _fbg_fragment *fragment = fbg->fragments[i];
 
-#ifndef FBG_LFDS
-            // wait till back buffer is consumed (synchronization mechanism; dumb busy wait for now)
-            fbg_fragment->sync_wait = 1;
-            while (fbg_fragment->sync_wait == 1 && fbg_fragment->state);
-#endif
-            fbg_computeFramerate(fbg, 0);
+                while (fragment->mixing_buffer && fragment->mixing_frame.sequence < sequence && atomic_load(&fragment->state)) {
+                    fbg_dropFragmentBuffer(fragment);
+                }
+
+                if (!fragment->mixing_buffer || !atomic_load(&fragment->state)) {
+                    // terminated
+                    return;
+                }
+
+                if (fragment->mixing_frame.sequence != sequence) {
+                    matching = 0;
+                }
+            }
         }
     }
+}
 
-    if (fbg_fragment->user_fragment_stop) {
-        fbg_fragment->user_fragment_stop(fbg, fbg_fragment->user_data);
+// 1 when the mixing leave the back buffer untouched where the fragment buffer is black so that it can be restricted to the fragment dirty area
+int fbg_mixingBounded(struct _fbg *fbg, void (*user_mixing)(struct _fbg *fbg, unsigned char *buffer, int task_id), int task_id) {
+    struct _fbg_mixing *mixing = fbg_getMixing(fbg, task_id);
+
+    int black_colorkey = (mixing->colorkey.r == 0 && mixing->colorkey.g == 0 && mixing->colorkey.b == 0);
+
+    if (user_mixing == fbg_taskMixing) {
+        switch (mixing->mode) {
+            case FBG_MIXING_ADDITIVE:
+            case FBG_MIXING_MAX:
+            case FBG_MIXING_SCREEN:
+                return 1;
+            case FBG_MIXING_COLORKEY:
+            case FBG_MIXING_ALPHA_COLORKEY:
+                return black_colorkey;
+            default:
+                return 0;
+        }
     }
 
-    //fprintf(stdout, "fbg_fragment: Task ended successfully.\n");
+    if (user_mixing == fbg_colorkeyMixing || user_mixing == fbg_alphaColorkeyMixing) {
+        return black_colorkey;
+    }
+
+    return (user_mixing == fbg_additiveMixing || user_mixing == fbg_maxMixing || user_mixing == fbg_screenMixing);
 }
 
-void fbg_createFragment(struct _fbg *fbg,
-        void *(*user_fragment_start)(struct _fbg *fbg),
-        void (*user_fragment)(struct _fbg *fbg, void *user_data),
-        void (*user_fragment_stop)(struct _fbg *fbg, void *user_data),
-        unsigned int parallel_tasks) {
-    if (parallel_tasks < 1) {
+// add the area of the back buffer changed by a fragment frame to the dirty area
+void fbg_dirtyFragment(struct _fbg *fbg, void (*user_mixing)(struct _fbg *fbg, unsigned char *buffer, int task_id), int task_id) {
+    struct _fbg_fragment *fragment = fbg->fragments[task_id - 1];
+
+    if (!fragment->mixing_buffer) {
         return;
     }
 
-    if (fbg->tasks) {
-        fbg_terminateFragments(fbg);
-        
-        fbg_freeTasks(fbg);
+    struct _fbg_bbox *dirty = &fragment->mixing_frame.dirty;
+
+    if (fragment->shared_buffer) {
+        // split rendering : the fragment drew into its area of the back buffer
+        struct _fbg_region *region = &fragment->fbg->region;
+
+        fbg_dirty(fbg, region->x + dirty->x1, region->y + dirty->y1 * region->row_step, dirty->x2 - dirty->x1, (dirty->y2 - dirty->y1 - 1) * region->row_step + 1);
+    } else if (fbg_mixingBounded(fbg, user_mixing, task_id)) {
+        fbg_dirty(fbg, dirty->x1, dirty->y1, dirty->x2 - dirty->x1, dirty->y2 - dirty->y1);
+    } else {
+        fbg_dirty(fbg, 0, 0, fbg->width, fbg->height);
     }
+}
 
-    fbg->parallel_tasks = parallel_tasks;
+// mix rows [y1, y2) of a fragment buffer into the main back buffer, only its dirty area when the mixing allow it
+void fbg_mixFragment(struct _fbg *fbg, void (*user_mixing)(struct _fbg *fbg, unsigned char *buffer, int task_id), int task_id, int y1, int y2) {
+    struct _fbg_fragment *fragment = fbg->fragments[task_id - 1];
 
-    fbg->tasks = (pthread_t *)malloc(sizeof(pthread_t) * fbg->parallel_tasks);
-    if (!fbg->tasks) {
-        fprintf(stderr, "fbg_createFragment: tasks malloc failed!\n");
+    // nothing completed yet (FBG_DRAW_LATEST)
+    if (!fragment->mixing_buffer) {
         return;
     }
 
-    fbg->fragments = (struct _fbg_fragment **)malloc(sizeof(struct _fbg_fragment *) * fbg->parallel_tasks);
-    if (!fbg->fragments) {
-        fprintf(stderr, "fbg_createFragment: fragments malloc failed!\n");
+    int x1 = 0, x2 = fbg->width;
 
-        free(fbg->tasks);
+    if (fbg_mixingBounded(fbg, user_mixing, task_id)) {
+        struct _fbg_bbox *dirty = &fragment->mixing_frame.dirty;
+
+        x1 = _FBG_MAX(x1, dirty->x1);
+        x2 = _FBG_MIN(x2, dirty->x2);
+        y1 = _FBG_MAX(y1, dirty->y1);
+        y2 = _FBG_MIN(y2, dirty->y2);
+
+        if (x2 <= x1 || y2 <= y1) {
+            return;
+        }
+    }
+
+    if (x1 == 0 && y1 == 0 && x2 == fbg->width && y2 == fbg->height) {
+        user_mixing(fbg, fragment->mixing_buffer, task_id);
 
         return;
     }
 
-    pthread_barrier_t *sync_barrier = (pthread_barrier_t *)malloc(sizeof(pthread_barrier_t));
+    int offset = y1 * fbg->line_length + x1 * fbg->components;
 
-    int err = pthread_barrier_init(sync_barrier, NULL, fbg->parallel_tasks);
-    if (err) {
-        fprintf(stderr, "fbg_createFragment: pthread_barrier_init failed!\n");
+    // view of the main context restricted to the area so that mixing functions can be used unchanged (built-in ones handle views narrower than line_length)
+    struct _fbg view;
+    memcpy(&view, fbg, sizeof(struct _fbg));
 
-        free(fbg->tasks);
-        free(fbg->fragments);
+    view.back_buffer = fbg->back_buffer + offset;
+    view.width = x2 - x1;
+    view.height = y2 - y1;
+    view.width_n_height = view.width * view.height;
+    view.size = fbg->line_length * (view.height - 1) + view.width * fbg->components;
+    view.region.x += x1;
+    view.region.y += y1;
 
-        return;
+    user_mixing(&view, fragment->mixing_buffer + offset, task_id);
+}
+
+// mix all fragments buffers into a stripe of the main back buffer
+void fbg_mixStripe(struct _fbg_job *job, int stripe) {
+    struct _fbg_mixing_stripes *stripes = (struct _fbg_mixing_stripes *)job->data;
+    struct _fbg *fbg = stripes->fbg;
+
+    int y = stripe * stripes->stripe_height;
+    int height = _FBG_MIN(stripes->stripe_height, fbg->height - y);
+
+    int i = 0;
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        fbg_mixFragment(fbg, stripes->user_mixing, i + 1, y, y + height);
     }
+}
 
-    fbg->sync_barrier = sync_barrier;
+// give back the fragments buffers once mixed (FBG_DRAW_LATEST keep them till a newer one is completed)
+void fbg_releaseFragmentBuffers(struct _fbg *fbg) {
+    if (fbg->draw_policy == FBG_DRAW_LATEST) {
+        return;
+    }
 
     int i = 0;
-    int created_tasks = 0;
     for (i = 0; i < fbg->parallel_tasks; i += 1) {
-        // create a task fbg structure for each threads
-        struct _fbg *task_fbg = (struct _fbg *)calloc(1, sizeof(struct _fbg));
-        if (!task_fbg) {
-            fprintf(stderr, "fbg_createFragment: task_fbg calloc failed!\n");
-            continue;
-        }
-
-        //memcpy(&task_fbg->vinfo, &fbg->vinfo, sizeof(struct fb_var_screeninfo));
-        //memcpy(&task_fbg->finfo, &fbg->finfo, sizeof(struct fb_fix_screeninfo));
+        fbg_releaseFragmentBuffer(fbg->fragments[i]);
+    }
+}
 
-        task_fbg->components = fbg->components;
-        task_fbg->comp_offset = fbg->comp_offset;
-        task_fbg->line_length = fbg->line_length;
+void fbg_draw(struct _fbg *fbg, void (*user_mixing)(struct _fbg *fbg, unsigned char *buffer, int task_id)) {
+    int i = 0;
 
-        task_fbg->width = fbg->width;
-        task_fbg->height = fbg->height;
+    if (user_mixing == NULL) {
+        user_mixing = fbg_taskMixing;
+    }
 
-        task_fbg->parallel_tasks = fbg->parallel_tasks;
+    // parked by idle detection : nothing to mix till fbg_wake()
+    int parallel_tasks = fbg->idle.parked ? 0 : fbg->parallel_tasks;
 
-        task_fbg->width_n_height = task_fbg->width * task_fbg->height;
+    if (fbg->fragments_pooled && parallel_tasks > 0) {
+        fbg_submitFragments(fbg);
 
-        task_fbg->size = task_fbg->width * task_fbg->height * task_fbg->components;
+        // the calling thread help meanwhile (FBG_DRAW_LATEST does not wait unless nobody else would run the frame)
+        if (fbg->draw_policy != FBG_DRAW_LATEST || fbg->fragments[0]->shared_buffer || fbg->pool->workers_count == 0) {
+            fbg_waitTaskGroup(fbg, &fbg->fragments_group);
+        }
+    }
 
-        struct _fbg_fragment *frag = (struct _fbg_fragment *)calloc(1, sizeof(struct _fbg_fragment));
-        if (!frag) {
-            fprintf(stderr, "fbg_createFragment: frag calloc failed!\n");
+    // unchanged frame (calling thread and all fragments reported it) : not mixed nor presented
+    fbg->idle.skip = (fbg->idle.mode & FBG_IDLE_EXPLICIT) && fbg->idle.unchanged;
 
-            free(task_fbg);
+    if (parallel_tasks > 0) {
+        fbg_acquireFragmentBuffers(fbg);
 
-            continue;
+        for (i = 0; i < parallel_tasks && fbg->idle.skip; i += 1) {
+            if (!fbg->fragments[i]->mixing_frame.unchanged) {
+                fbg->idle.skip = 0;
+            }
         }
 
-        // liblfds
-#ifdef FBG_LFDS
-        frag->ringbuffer_element = aligned_alloc(LFDS720_PAL_ATOMIC_ISOLATION_LENGTH_IN_BYTES, sizeof(struct lfds720_ringbuffer_n_element) * (fbg->fragment_queue_size + 1));
-        if (frag->ringbuffer_element == NULL) {
-            fprintf(stderr, "fbg_createFragment: liblfds ringbuffer data structures aligned_alloc error.\n");
+        if (fbg->dirty_tracking && !fbg->idle.skip) {
+            for (i = 0; i < parallel_tasks; i += 1) {
+                fbg_dirtyFragment(fbg, user_mixing, i + 1);
+            }
+        }
 
-            free(task_fbg);
-            free(frag);
+        uint64_t mixing_start = fbg_timeNs();
 
-            continue;
-        }
+        if (fbg->fragments[0]->shared_buffer) {
+            // split rendering : fragments draw directly into the back buffer, nothing to mix, they are released by fbg_flip
+        } else if (fbg->idle.skip) {
+            fbg_releaseFragmentBuffers(fbg);
+        } else if (fbg->mixing_stripes > 0 && fbg->height > 0) {
+            struct _fbg_mixing_stripes stripes;
+            stripes.fbg = fbg;
+            stripes.user_mixing = user_mixing;
+            stripes.stripe_height = (fbg->height + fbg->mixing_stripes - 1) / fbg->mixing_stripes;
 
-        frag->ringbuffer_state = aligned_alloc(LFDS720_PAL_ATOMIC_ISOLATION_LENGTH_IN_BYTES, sizeof(struct lfds720_ringbuffer_n_state));
-        if (frag->ringbuffer_state == NULL) {
-            fprintf(stderr, "fbg_createFragment: liblfds ringbuffer state aligned_alloc error.\n");
+            fbg_runJob(fbg, fbg_mixStripe, &stripes, (fbg->height + stripes.stripe_height - 1) / stripes.stripe_height);
 
-            free(task_fbg);
-            free(frag);
-            free(frag->ringbuffer_element);
+            fbg_releaseFragmentBuffers(fbg);
+        } else {
+            for (i = 0; i < fbg->parallel_tasks; i += 1) {
+                fbg_mixFragment(fbg, user_mixing, i + 1, 0, fbg->height);
+            }
 
-            continue;
+            fbg_releaseFragmentBuffers(fbg);
         }
 
-        frag->freelist_state = aligned_alloc(LFDS720_PAL_ATOMIC_ISOLATION_LENGTH_IN_BYTES, sizeof(struct lfds720_freelist_n_state));
-        if (frag->freelist_state == NULL) {
-            fprintf(stderr, "fbg_createFragment: liblfds freelist state aligned_alloc error.\n");
+        fbg->adaptive.mixing_time += fbg_timeNs() - mixing_start;
 
-            free(task_fbg);
-            free(frag);
-            free(frag->ringbuffer_element);
-            free(frag->ringbuffer_state);
-
-            continue;
+        // pooled fragments can draw the next frame into their released buffers while the calling thread draw overlays / flip
+        if (!fbg->fragments[0]->shared_buffer) {
+            fbg_submitFragments(fbg);
         }
-
-        lfds720_ringbuffer_n_init_valid_on_current_logical_core(frag->ringbuffer_state, frag->ringbuffer_element, (fbg->fragment_queue_size + 1), NULL);
-#ifdef LFDS711
-        lfds720_freelist_n_init_valid_on_current_logical_core(frag->freelist_state, NULL, 0, NULL);
+    }
 #else
-        lfds720_freelist_n_init_valid_on_current_logical_core(frag->freelist_state, NULL);
+void fbg_draw(struct _fbg *fbg) {
+    fbg->idle.skip = (fbg->idle.mode & FBG_IDLE_EXPLICIT) && fbg->idle.unchanged;
 #endif
+    // the display buffer did not change since the last presentation when fbg_flip() skipped the previous frame
+    if (fbg->user_draw && (!fbg->idle.mode || fbg->idle.presented)) {
+        fbg->user_draw(fbg);
+    }
 
-        frag->fbg_freelist_data = malloc(sizeof(struct _fbg_freelist_data) * fbg->fragment_queue_size);
-        if (frag->fbg_freelist_data == NULL) {
-            fprintf(stderr, "fbg_createFragment: fbg_freelist_data malloc error.\n");
-
-            free(task_fbg);
-            free(frag->ringbuffer_element);
-            free(frag->ringbuffer_state);
-            free(frag->freelist_state);
-            free(frag);
+    // resize the context (registered) by fbg_pushResize if needed
+    // note : we process the resize event here to be sure that a single resize is processed in the main thread, avoiding potential issues with fragments / caller thread
+    if (fbg->new_width > 0 && fbg->new_height > 0) {
+        fbg_resize(fbg, fbg->new_width, fbg->new_height);
 
-            continue;
-        }
+        fbg->new_width = 0;
+        fbg->new_height = 0;
+    }
+}
 
-        // allocate buffers
-        int j = 0;
-        for (j = 0; j < fbg->fragment_queue_size; j += 1) {
-            frag->fbg_freelist_data[j].buffer = calloc(1, sizeof(unsigned char) * task_fbg->size);
+void fbg_flip(struct _fbg *fbg) {
+#ifdef FBG_PARALLEL
+    if (fbg->frame_pacing > 0) {
+        fbg_paceFrame(fbg);
+    }
 
-            LFDS720_FREELIST_N_SET_VALUE_IN_ELEMENT(frag->fbg_freelist_data[j].freelist_element, &frag->fbg_freelist_data[j]);
-#ifdef LFDS711
-            lfds720_freelist_n_threadsafe_push(frag->freelist_state, &frag->fbg_freelist_data[j].freelist_element, NULL);
-#else
-            lfds720_freelist_n_threadsafe_push(frag->freelist_state, NULL, &frag->fbg_freelist_data[j].freelist_element);
+    uint64_t flip_start = fbg_timeNs();
 #endif
-        }
-        //
-#else
-        task_fbg->back_buffer = calloc(1, sizeof(unsigned char) * task_fbg->size);
-        if (!task_fbg->back_buffer) {
-            fprintf(stderr, "fbg_createFragment: frag back. buffer calloc failed!\n");
 
-            free(task_fbg);
-            free(frag);
+    // unchanged frames are not presented (see fbg_setIdleDetection())
+    fbg->idle.presented = (!fbg->idle.mode || fbg_idleFrame(fbg));
 
-            continue;
+    if (fbg->idle.presented) {
+        if (fbg->dirty_tiles) {
+            fbg_presentTiles(fbg->dirty_tiles);
         }
-#endif
-
-        task_fbg->sync_barrier = fbg->sync_barrier;
-        task_fbg->task_id = created_tasks + 1;
-
-        //frag->queue_size = fbg->fragment_queue_size;
-        frag->fbg = task_fbg;
-        frag->state = 1;
 
-        frag->user_fragment_start = user_fragment_start;
-        frag->user_fragment = user_fragment;
-        frag->user_fragment_stop = user_fragment_stop;
+        if (fbg->user_flip) {
+            fbg->user_flip(fbg);
+        } else {
+            unsigned char *tmp_buffer = fbg->disp_buffer;
+            fbg->disp_buffer = fbg->back_buffer;
+            fbg->back_buffer = tmp_buffer;
+        }
+    } else {
+#ifdef FBG_PARALLEL
+        // already paced by fbg_paceFrame()
+        if (fbg->frame_pacing == 0) {
+            fbg_paceIdleFrame(fbg);
+        }
+#else
+        fbg_paceIdleFrame(fbg);
+#endif
+    }
 
-        fbg->fragments[created_tasks] = frag;
+#ifdef FBG_PARALLEL
+    // split rendering : fragments can draw the next frame into the new back buffer
+    int i = 0;
+    for (i = 0; i < fbg->parallel_tasks; i += 1) {
+        struct _fbg_fragment *fragment = fbg->fragments[i];
 
-        int err = pthread_create(&fbg->tasks[created_tasks], NULL, (void * (*)(void *))fbg_fragment, frag);
-        if (err) {
-            fprintf(stderr, "fbg_createFragment: pthread_create error '%i'!\n", err);
+        if (fragment->shared_buffer && fragment->mixing_buffer) {
+            fbg_releaseFragmentBuffer(fragment);
+        }
+    }
 
-            free(task_fbg);
-#ifdef FBG_LFDS
-            lfds720_ringbuffer_n_cleanup(frag->ringbuffer_state, fbg_ringbufferCleanup);
-            lfds720_freelist_n_cleanup(frag->freelist_state, fbg_freelistCleanup);
-            free(frag->ringbuffer_element);
-            free(frag->ringbuffer_state);
-            free(frag->freelist_state);
-            free(frag->fbg_freelist_data);
-#endif
-            free(frag);
+    // static content : fragments sleep till fbg_wake()
+    if (fbg->idle.park_frames > 0 && fbg->idle.frames >= fbg->idle.park_frames && !fbg->idle.parked && fbg->parallel_tasks > 0) {
+        fbg_parkFragments(fbg);
 
-            continue;
-        }
+        fbg->idle.parked = 1;
 
-        created_tasks += 1;
+        // the first parked frame become the FBG_IDLE_HASH reference (see fbg_idleFrame())
+        fbg->idle.hashed = 0;
     }
 
-    if (fbg->parallel_tasks != created_tasks) {
-        fprintf(stderr, "fbg_createFragment: Some of the specified number of tasks failed to initialize, as such no tasks were created.\n");
-
-        fbg_freeTasks(fbg);
+    // pooled fragments can draw the next frame into the new back buffer (split rendering, other modes submit it once buffers are released by fbg_draw())
+    if (fbg->parallel_tasks > 0 && fbg->fragments[0]->shared_buffer && !fbg->idle.parked) {
+        fbg_submitFragments(fbg);
+    }
 
-        fbg->parallel_tasks = 0;
+    if (fbg->adaptive.target_time > 0 && !fbg->idle.parked) {
+        fbg_adaptFragments(fbg, flip_start, fbg_timeNs());
     }
-}
 #endif
 
-void fbg_fill(struct _fbg *fbg, unsigned char r, unsigned char g, unsigned char b) {
-    fbg->fill_color.r = r;
-    fbg->fill_color.g = g;
-    fbg->fill_color.b = b;
+    fbg_computeFramerate(fbg, 1);
 }
 
-void fbg_pixel(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b) {
-    char *pix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
+void fbg_setDirtyTracking(struct _fbg *fbg, int enable) {
+    fbg->dirty_tracking = enable ? 1 : 0;
+
+    // anything may have been drawn already
+    fbg->dirty.x1 = 0;
+    fbg->dirty.y1 = 0;
+    fbg->dirty.x2 = fbg->width;
+    fbg->dirty.y2 = fbg->height;
 
-    *pix_pointer++ = r;
-    *pix_pointer++ = g;
-    *pix_pointer++ = b;
-    pix_pointer += fbg->comp_offset;
+    if (!enable) {
+        // tiles are not updated anymore
+        fbg_setDirtyTiles(fbg, 0);
+    } else if (fbg->dirty_tiles && fbg->width > 0 && fbg->height > 0) {
+        fbg_markTiles(fbg->dirty_tiles, 0, 0, fbg->width, fbg->height);
+    }
 }
 
-void fbg_pixela(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
-    char *pix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
+// a black buffer is untouched
+void fbg_resetDirty(struct _fbg *fbg) {
+    fbg->dirty.x1 = fbg->dirty.y1 = fbg->dirty.x2 = fbg->dirty.y2 = 0;
 
-    *pix_pointer = ((a * r + (255 - a) * (*pix_pointer)) >> 8);
-    pix_pointer += 1;
-    *pix_pointer = ((a * g + (255 - a) * (*pix_pointer)) >> 8);
-    pix_pointer += 1;
-    *pix_pointer = ((a * b + (255 - a) * (*pix_pointer)) >> 8);
-    pix_pointer += 1;
-    pix_pointer += fbg->comp_offset;
+    if (fbg->dirty_tiles) {
+        memset(fbg->dirty_tiles->touched, 0, fbg->dirty_tiles->row_words * fbg->dirty_tiles->tiles_y * sizeof(uint32_t));
+    }
 }
 
-void fbg_fpixel(struct _fbg *fbg, int x, int y) {
-    char *pix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length));
+void fbg_setDirtyTiles(struct _fbg *fbg, int enable) {
+    free(fbg->dirty_tiles);
+    fbg->dirty_tiles = NULL;
 
-    memcpy(pix_pointer, &fbg->fill_color, fbg->components);
-}
+    if (enable) {
+        fbg->dirty_tiles = fbg_allocTiles(fbg->width, fbg->height);
 
-void fbg_plot(struct _fbg *fbg, int index, unsigned char value) {
-    fbg->back_buffer[index] = value;
+        fbg_setDirtyTracking(fbg, 1);
+    }
 }
 
-void fbg_hline(struct _fbg *fbg, int x, int y, int w, unsigned char r, unsigned char g, unsigned char b) {
-    int xx;
+int fbg_getPresentRects(struct _fbg *fbg, struct _fbg_bbox **rects) {
+    struct _fbg_tiles *tiles = fbg->dirty_tiles;
 
-    char *pix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
+    *rects = NULL;
 
-    for (xx = 0; xx < w; xx += 1) {
-        *pix_pointer++ = r;
-        *pix_pointer++ = g;
-        *pix_pointer++ = b;
-        pix_pointer += fbg->comp_offset;
+    if (!tiles) {
+        return -1;
     }
-}
 
-void fbg_vline(struct _fbg *fbg, int x, int y, int h, unsigned char r, unsigned char g, unsigned char b) {
-    int yy;
+    int count = 0, area = 0;
 
-    char *pix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
+    if (!tiles->full) {
+        int *previous_active = tiles->active;
+        int *current_active = tiles->active + tiles->tiles_x;
+        int previous_count = 0;
 
-    for (yy = 0; yy < h; yy += 1) {
-        *pix_pointer++ = r;
-        *pix_pointer++ = g;
-        *pix_pointer++ = b;
-
-        pix_pointer += fbg->line_length - 3;
-    }
-}
-
-// source : http://www.brackeen.com/vga/shapes.html
-void fbg_line(struct _fbg *fbg, int x1, int y1, int x2, int y2, unsigned char r, unsigned char g, unsigned char b) {
-    int i, dx, dy, sdx, sdy, dxabs, dyabs, x, y, px, py;
-
-    dx = x2 - x1;
-    dy = y2 - y1;
-    dxabs = abs(dx);
-    dyabs = abs(dy);
-    sdx = _FBG_SGN(dx);
-    sdy = _FBG_SGN(dy);
-    x = dyabs >> 1;
-    y = dxabs >> 1;
-    px = x1;
-    py = y1;
-
-    char *pix_pointer = (char *)(fbg->back_buffer + (py * fbg->line_length + px * fbg->components));
-
-    *pix_pointer++ = r;
-    *pix_pointer++ = g;
-    *pix_pointer++ = b;
-    pix_pointer += fbg->comp_offset;
-
-    if (dxabs >= dyabs) {
-        for (i = 0; i < dxabs; i += 1) {
-            y += dyabs;
-            if (y >= dxabs)
-            {
-                y -= dxabs;
-                py += sdy;
-            }
-            px += sdx;
+        int tx = 0, ty = 0;
+        for (ty = 0; ty < tiles->tiles_y; ty += 1) {
+            uint32_t *row = tiles->pending + ty * tiles->row_words;
 
-            fbg_pixel(fbg, px, py, r, g, b);
-        }
-    } else {
-        for (i = 0; i < dyabs; i += 1) {
-            x += dxabs;
-            if (x >= dyabs)
-            {
-                x -= dyabs;
-                px += sdx;
-            }
-            py += sdy;
+            int y1 = ty * FBG_TILE_SIZE;
+            int y2 = _FBG_MIN(y1 + FBG_TILE_SIZE, fbg->height);
 
-            fbg_pixel(fbg, px, py, r, g, b);
-        }
-    }
-}
+            int current_count = 0, p = 0;
 
-void fbg_polygon(struct _fbg *fbg, int num_vertices, int *vertices, unsigned char r, unsigned char g, unsigned char b) {
-    int i;
+            tx = 0;
+            while (tx < tiles->tiles_x) {
+                if (!((row[tx >> 5] >> (tx & 31)) & 1)) {
+                    tx += 1;
 
-    for (i = 0; i < num_vertices - 1; i += 1) {
-        fbg_line(fbg, vertices[(i << 1) + 0],
-            vertices[(i << 1) + 1],
-            vertices[(i << 1) + 2],
-            vertices[(i << 1) + 3],
-            r, g, b);
-    }
+                    continue;
+                }
 
-    fbg_line(fbg, vertices[0],
-         vertices[1],
-         vertices[(num_vertices << 1) - 2],
-         vertices[(num_vertices << 1) - 1],
-         r, g, b);
-}
+                // run of changed tiles, gaps of up to 2 unchanged tiles are joined (one longer copy is cheaper than two short ones on uncached memory)
+                int first = tx, last = tx, gap = 0;
+                for (tx += 1; tx < tiles->tiles_x; tx += 1) {
+                    if ((row[tx >> 5] >> (tx & 31)) & 1) {
+                        last = tx;
+                        gap = 0;
+                    } else if (++gap > 2) {
+                        break;
+                    }
+                }
 
-void fbg_recta(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
-    int xx = 0, yy = 0, w3 = w * fbg->components;
+                tx = last + 1;
 
-    char *pix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
+                int x1 = first * FBG_TILE_SIZE;
+                int x2 = _FBG_MIN((last + 1) * FBG_TILE_SIZE, fbg->width);
 
-    for (yy = 0; yy < h; yy += 1) {
-        for (xx = 0; xx < w; xx += 1) {
-            *pix_pointer = ((a * r + (255 - a) * (*pix_pointer)) >> 8);
-            pix_pointer += 1;
-            *pix_pointer = ((a * g + (255 - a) * (*pix_pointer)) >> 8);
-            pix_pointer += 1;
-            *pix_pointer = ((a * b + (255 - a) * (*pix_pointer)) >> 8);
-            pix_pointer += 1;
-            pix_pointer += fbg->comp_offset;
-        }
+                // extend the area of the previous row with the same columns (runs are sorted)
+                while (p < previous_count && tiles->rects[previous_active[p]].x1 < x1) {
+                    p += 1;
+                }
 
-        pix_pointer += (fbg->line_length - w3);
-    }
-}
+                int index = 0;
+                if (p < previous_count && tiles->rects[previous_active[p]].x1 == x1 && tiles->rects[previous_active[p]].x2 == x2) {
+                    index = previous_active[p];
 
-void fbg_rect(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b) {
-    int xx = 0, yy = 0, w3 = w * fbg->components;
+                    tiles->rects[index].y2 = y2;
 
-    char *pix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
+                    p += 1;
+                } else {
+                    index = count;
 
-    for (yy = 0; yy < h; yy += 1) {
-        for (xx = 0; xx < w; xx += 1) {
-            *pix_pointer++ = r;
-            *pix_pointer++ = g;
-            *pix_pointer++ = b;
-            pix_pointer += fbg->comp_offset;
-        }
+                    tiles->rects[index].x1 = x1;
+                    tiles->rects[index].y1 = y1;
+                    tiles->rects[index].x2 = x2;
+                    tiles->rects[index].y2 = y2;
 
-        pix_pointer += (fbg->line_length - w3);
-    }
-}
+                    count += 1;
+                }
 
-void fbg_frect(struct _fbg *fbg, int x, int y, int w, int h) {
-    int xx, yy, w3 = w * fbg->components;
+                current_active[current_count] = index;
+                current_count += 1;
 
-    char *fpix_pointer = (char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
+                area += (x2 - x1) * (y2 - y1);
+            }
 
-    char *org_pointer = fpix_pointer;
-    char *pix_pointer = fpix_pointer;
+            int *tmp_active = previous_active;
+            previous_active = current_active;
+            current_active = tmp_active;
 
-    for (xx = 0; xx < w; xx += 1) {
-        *pix_pointer++ = fbg->fill_color.r;
-        *pix_pointer++ = fbg->fill_color.g;
-        *pix_pointer++ = fbg->fill_color.b;
-        pix_pointer += fbg->comp_offset;
+            previous_count = current_count;
+        }
     }
 
-    for (yy = 1; yy < h; yy += 1) {
-        fpix_pointer += fbg->line_length;
+    memset(tiles->pending, 0, tiles->row_words * tiles->tiles_y * sizeof(uint32_t));
 
-        memcpy(fpix_pointer, org_pointer, w3);
-    }
-}
+    // most of the display : a single copy
+    if (tiles->full || area * 4 >= fbg->width * fbg->height * 3) {
+        tiles->full = 0;
 
-void fbg_getPixel(struct _fbg *fbg, int x, int y, struct _fbg_rgb *color) {
-    int ofs = y * fbg->line_length + x * fbg->components;
+        return -1;
+    }
 
-    memcpy(color, (char *)(fbg->back_buffer + ofs), fbg->components);
-}
+    *rects = tiles->rects;
 
-#ifdef FBG_PARALLEL
-void fbg_additiveMixing(struct _fbg *fbg, unsigned char *buffer, int task_id) {
-    int j = 0;
-    for (j = 0; j < fbg->size; j += 1) {
-        fbg->back_buffer[j] = _FBG_MIN(fbg->back_buffer[j] + buffer[j], 255);
-    }
+    return count;
 }
 
-void fbg_draw(struct _fbg *fbg, void (*user_mixing)(struct _fbg *fbg, unsigned char *buffer, int task_id)) {
-    int i = 0;
+void fbg_setIdleDetection(struct _fbg *fbg, int mode, int park_frames) {
+    fbg->idle.mode = mode;
+    fbg->idle.park_frames = _FBG_MAX(park_frames, 0);
 
-    if (user_mixing == NULL) {
-        user_mixing = fbg_additiveMixing;
-    }
+    // frames were presented till now
+    fbg->idle.presented = 1;
 
-#ifdef FBG_LFDS
-    void *key;
-    int ringbuffer_read_status = 0;
-#endif
+    fbg_wake(fbg);
+}
 
-    for (i = 0; i < fbg->parallel_tasks; i += 1) {
-        struct _fbg_fragment *fragment = fbg->fragments[i];
-#ifdef FBG_LFDS
-        struct _fbg_freelist_data *freelist_data;
-        unsigned char *task_buffer = NULL;
+void fbg_unchanged(struct _fbg *fbg) {
+    fbg->idle.unchanged = 1;
+}
 
-        //if (sync_with_tasks) {
-            while ((ringbuffer_read_status = lfds720_ringbuffer_n_read(fragment->ringbuffer_state, &key, NULL)) != 1) {
+void fbg_wake(struct _fbg *fbg) {
+#ifdef FBG_PARALLEL
+    if (fbg->idle.parked) {
+        fbg_resumeFragments(fbg);
 
-            }
-        /*} else {
-            ringbuffer_read_status = lfds720_ringbuffer_n_read(fragment->ringbuffer_state, &key, NULL);
-        }*/
+        fbg->idle.parked = 0;
 
-        if (ringbuffer_read_status == 1) {
-            freelist_data = (struct _fbg_freelist_data *)key;
+        // parked frames are not representative
+        fbg_resetAdaptiveWindow(fbg);
+    }
+#endif
 
-            task_buffer = freelist_data->buffer;
+    fbg->idle.frames = 0;
+}
 
-            //fbg->curr_task_buffer = task_buffer;
+int fbg_isIdle(struct _fbg *fbg) {
+    return fbg->idle.frames;
+}
 
-            user_mixing(fbg, task_buffer, i + 1);
+void fbg_dirty(struct _fbg *fbg, int x, int y, int w, int h) {
+    if (!fbg->dirty_tracking || w <= 0 || h <= 0) {
+        return;
+    }
 
-            LFDS720_FREELIST_N_SET_VALUE_IN_ELEMENT(freelist_data->freelist_element, freelist_data);
-#ifdef LFDS711
-            lfds720_freelist_n_threadsafe_push(fragment->freelist_state, &freelist_data->freelist_element, NULL);
-#else
-            lfds720_freelist_n_threadsafe_push(fragment->freelist_state, NULL, &freelist_data->freelist_element);
-#endif
-            
-        }
-#else
-        while (fragment->sync_wait == 0 && fragment->state != 0);
+    struct _fbg_bbox *dirty = &fbg->dirty;
 
-        user_mixing(fbg, fragment->fbg->back_buffer, i + 1);
-        
-        fragment->sync_wait = 0;
-#endif
-    }
-#else
-void fbg_draw(struct _fbg *fbg) {
-#endif
-    if (fbg->user_draw) {
-        fbg->user_draw(fbg);
-    }
+    int x2 = _FBG_MIN(x + w, fbg->width);
+    int y2 = _FBG_MIN(y + h, fbg->height);
 
-    // resize the context (registered) by fbg_pushResize if needed
-    // note : we process the resize event here to be sure that a single resize is processed in the main thread, avoiding potential issues with fragments / caller thread
-    if (fbg->new_width > 0 && fbg->new_height > 0) {
-        fbg_resize(fbg, fbg->new_width, fbg->new_height);
+    x = _FBG_MAX(x, 0);
+    y = _FBG_MAX(y, 0);
 
-        fbg->new_width = 0;
-        fbg->new_height = 0;
+    if (x2 <= x || y2 <= y) {
+        return;
     }
-}
 
-void fbg_flip(struct _fbg *fbg) {
-    if (fbg->user_flip) {
-        fbg->user_flip(fbg);
+    if (dirty->x2 <= dirty->x1 || dirty->y2 <= dirty->y1) {
+        dirty->x1 = x;
+        dirty->y1 = y;
+        dirty->x2 = x2;
+        dirty->y2 = y2;
     } else {
-        unsigned char *tmp_buffer = fbg->disp_buffer;
-        fbg->disp_buffer = fbg->back_buffer;
-        fbg->back_buffer = tmp_buffer;
+        dirty->x1 = _FBG_MIN(dirty->x1, x);
+        dirty->y1 = _FBG_MIN(dirty->y1, y);
+        dirty->x2 = _FBG_MAX(dirty->x2, x2);
+        dirty->y2 = _FBG_MAX(dirty->y2, y2);
     }
 
-    fbg_computeFramerate(fbg, 1);
+    if (fbg->dirty_tiles) {
+        fbg_markTiles(fbg->dirty_tiles, x, y, x2, y2);
+    }
 }
 
 void fbg_clear(struct _fbg *fbg, unsigned char color) {
-    memset(fbg->back_buffer, color, fbg->size);
-}
+    int row_length = fbg->width * fbg->components;
 
-void fbg_fadeDown(struct _fbg *fbg, unsigned char rgb_fade_amount) {
-    int i = 0;
+    fbg_resetDirty(fbg);
 
-    char *pix_pointer = (char *)(fbg->back_buffer);
+    if (color) {
+        fbg_dirty(fbg, 0, 0, fbg->width, fbg->height);
+    }
 
-    for (i = 0; i < fbg->width_n_height; i += 1) {
-        *pix_pointer = _FBG_MAX(*pix_pointer - rgb_fade_amount, 0);
-        pix_pointer++;
-        *pix_pointer = _FBG_MAX(*pix_pointer - rgb_fade_amount, 0);
-        pix_pointer++;
-        *pix_pointer = _FBG_MAX(*pix_pointer - rgb_fade_amount, 0);
-        pix_pointer++;
-        pix_pointer += fbg->comp_offset;
+    if (fbg->line_length == row_length) {
+        memset(fbg->back_buffer, color, fbg->size);
+    } else {
+        int y = 0;
+        for (y = 0; y < fbg->height; y += 1) {
+            memset(fbg->back_buffer + y * fbg->line_length, color, row_length);
+        }
     }
 }
 
-void fbg_fadeUp(struct _fbg *fbg, unsigned char rgb_fade_amount) {
-    int i = 0;
+void fbg_fadeDown(struct _fbg *fbg, unsigned char rgb_fade_amount) {
+    fbg->primitives.fade(fbg, rgb_fade_amount, 0);
+}
 
-    char *pix_pointer = (char *)(fbg->back_buffer);
+void fbg_fadeUp(struct _fbg *fbg, unsigned char rgb_fade_amount) {
+    fbg_dirty(fbg, 0, 0, fbg->width, fbg->height);
 
-    for (i = 0; i < fbg->width_n_height; i += 1) {
-        *pix_pointer = _FBG_MIN(*pix_pointer + rgb_fade_amount, 255);
-        pix_pointer++;
-        *pix_pointer = _FBG_MIN(*pix_pointer + rgb_fade_amount, 255);
-        pix_pointer++;
-        *pix_pointer = _FBG_MIN(*pix_pointer + rgb_fade_amount, 255);
-        pix_pointer++;
-        pix_pointer += fbg->comp_offset;
-    }
+    fbg->primitives.fade(fbg, rgb_fade_amount, 1);
 }
 
 void fbg_background(struct _fbg *fbg, unsigned char r, unsigned char g, unsigned char b) {
-    int i = 0;
+    _FBG_NATIVE_RGB(fbg, r, b);
 
-    char *pix_pointer = (char *)(fbg->back_buffer);
+    fbg_resetDirty(fbg);
 
-    for (i = 0; i < fbg->width_n_height; i += 1) {
-        *pix_pointer = r;
-        pix_pointer++;
-        *pix_pointer = g;
-        pix_pointer++;
-        *pix_pointer = b;
-        pix_pointer++;
-        pix_pointer += fbg->comp_offset;
+    if (r || g || b) {
+        fbg_dirty(fbg, 0, 0, fbg->width, fbg->height);
     }
+
+    fbg->primitives.rect(fbg, 0, 0, fbg->width, fbg->height, r, g, b);
 }
 
 float fbg_hue2rgb(float v1, float v2, float vH) {
@@ -1258,15 +4819,20 @@ struct _fbg_img *fbg_createImage(struct _fbg *fbg, unsigned int width, unsigned
         fprintf(stderr, "fbg_createImage : calloc failed!\n");
     }
 
-    img->data = calloc(1, (width * height * fbg->components) * sizeof(char));
+    // aligned for the SIMD kernels, still released with free() by fbg_freeImage() (image loaders may replace the data)
+    size_t size = _FBG_ALIGN_UP((size_t)width * height * fbg->components, FBG_BUFFER_ALIGNMENT);
+
+    img->data = aligned_alloc(FBG_BUFFER_ALIGNMENT, size);
     if (!img->data) {
-        fprintf(stderr, "fbg_createImage (%ix%i): calloc failed!\n", width, height);
+        fprintf(stderr, "fbg_createImage (%ix%i): aligned_alloc failed!\n", width, height);
 
         free(img);
 
         return NULL;
     }
 
+    memset(img->data, 0, size);
+
     img->width = width;
     img->height = height;
 
@@ -1425,6 +4991,22 @@ struct _fbg_img *fbg_loadPNG(struct _fbg *fbg, const char *filename) {
 #endif
 
 #ifndef WITHOUT_STB_IMAGE
+// swap the red and blue components of decoded RGB(A) pixels for BGR ordered formats
+void fbg_nativeImageData(struct _fbg *fbg, unsigned char *data, int pixels) {
+    if (!fbg->bgr) {
+        return;
+    }
+
+    int i;
+    for (i = 0; i < pixels; i += 1) {
+        unsigned char r = data[0];
+        data[0] = data[2];
+        data[2] = r;
+
+        data += fbg->components;
+    }
+}
+
 struct _fbg_img *fbg_loadSTBImage(struct _fbg *fbg, const char *filename) {
     unsigned char *data;
     int width;
@@ -1447,6 +5029,8 @@ struct _fbg_img *fbg_loadSTBImage(struct _fbg *fbg, const char *filename) {
         return NULL;
     }
 
+    fbg_nativeImageData(fbg, data, width * height);
+
     free(img->data);
     img->data = data;
 
@@ -1499,6 +5083,8 @@ struct _fbg_img *fbg_loadSTBImageFromMemory(struct _fbg *fbg, const unsigned cha
         return NULL;
     }
 
+    fbg_nativeImageData(fbg, output, width * height);
+
     free(img->data);
     img->data = output;
 
@@ -1522,6 +5108,8 @@ struct _fbg_img *fbg_loadImageFromMemory(struct _fbg *fbg, const unsigned char *
 }
 
 void fbg_image(struct _fbg *fbg, struct _fbg_img *img, int x, int y) {
+    fbg_dirty(fbg, x, y, img->width, img->height);
+
     unsigned char *pix_pointer = (unsigned char *)(fbg->back_buffer + (y * fbg->line_length) + x * fbg->components);
     unsigned char *img_pointer = img->data;
 
@@ -1536,30 +5124,11 @@ void fbg_image(struct _fbg *fbg, struct _fbg_img *img, int x, int y) {
 }
 
 void fbg_imageColorkey(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int cr, int cg, int cb) {
-    unsigned char *img_pointer = img->data;
-
-    int i = 0, j = 0;
-    
-    for (i = 0; i < img->height; i += 1) {
-        unsigned char *pix_pointer = (unsigned char *)(fbg->back_buffer + ((y + i) * fbg->line_length) + x * fbg->components);
-        for (j = 0; j < img->width; j += 1) {
-            int ir = *img_pointer++,
-                ig = *img_pointer++,
-                ib = *img_pointer++;
+    fbg_dirty(fbg, x, y, img->width, img->height);
 
-            img_pointer += fbg->comp_offset;
+    _FBG_NATIVE_RGB(fbg, cr, cb);
 
-            if (ir == cr && ig == cg && ib == cb) {
-                pix_pointer += fbg->components;
-                continue;
-            }
-
-            *pix_pointer++ = ir;
-            *pix_pointer++ = ig;
-            *pix_pointer++ = ib;
-            pix_pointer += fbg->comp_offset;
-        }
-    }
+    fbg->primitives.imageColorkey(fbg, img, x, y, cr, cg, cb);
 }
 
 void fbg_imageClip(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int cx, int cy, int cw, int ch) {
@@ -1572,6 +5141,8 @@ void fbg_imageClip(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int cx,
     int w3 = _FBG_MIN((cw - cx) * fbg->components, (fbg->width - x) * fbg->components);
     int h = ch - cy;
 
+    fbg_dirty(fbg, x, y, w3 / fbg->components, h);
+
     for (i = 0; i < h; i += 1) {
         memcpy(pix_pointer, img_pointer, w3);
         pix_pointer += fbg->line_length;
@@ -1595,39 +5166,7 @@ void fbg_imageFlip(struct _fbg_img *img) {
 }
 
 void fbg_imageEx(struct _fbg *fbg, struct _fbg_img *img, int x, int y, float sx, float sy, int cx, int cy, int cw, int ch) {
-    float x_ratio_inv = 1.0f / sx;
-    float y_ratio_inv = 1.0f / sy;
-
-    int px, py;
-    int cx2 = (float)cx * sx;
-    int cy2 = (float)cy * sy;
-    int w2 = (float)(cw + cx) * sx;
-    int h2 = (float)(ch + cy) * sy;
-    int i, j;
-
-    int d = w2 - cx2;
-
-    if (d >= (fbg->width - x)) {
-        w2 -= (d - (fbg->width - x));
-    }
-
-    unsigned char *pix_pointer = (unsigned char *)(fbg->back_buffer + (y * fbg->line_length + x * fbg->components));
-
-    for (i = cy2; i < h2; i += 1) {
-        py = floorf(x_ratio_inv * (float)i);
-
-        for (j = cx2; j < w2; j += 1) {
-            px = floorf(y_ratio_inv * (float)j);
-            
-            unsigned char *img_pointer = (unsigned char *)(img->data + ((px + py * img->width) * fbg->components));
-
-            memcpy(pix_pointer, img_pointer, fbg->components);
-
-            pix_pointer += fbg->components;
-        }
-
-        pix_pointer += fbg->line_length - (w2 - cx2) * fbg->components;
-    }
+    fbg->primitives.imageEx(fbg, img, x, y, sx, sy, cx, cy, cw, ch);
 }
 
 void fbg_freeImage(struct _fbg_img *img) {
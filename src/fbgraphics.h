@@ -37,38 +37,65 @@
     #include <stdatomic.h>
     #include <pthread.h>
 
-// compatibility layer for liblfds 711 version (because 720 was unreleased at the time of writing this)
 #ifdef FBG_LFDS
-#ifdef LFDS711
-    #include "liblfds711.h"
-
-    #define lfds720_freelist_n_element lfds711_freelist_element
-    #define lfds720_ringbuffer_n_element lfds711_ringbuffer_element
-    #define lfds720_ringbuffer_n_state lfds711_ringbuffer_state
-    #define lfds720_freelist_n_state lfds711_freelist_state
-    #define LFDS720_PAL_ATOMIC_ISOLATION_LENGTH_IN_BYTES LFDS711_PAL_ATOMIC_ISOLATION_IN_BYTES
-    #define lfds720_ringbuffer_n_init_valid_on_current_logical_core lfds711_ringbuffer_init_valid_on_current_logical_core
-    #define lfds720_freelist_n_init_valid_on_current_logical_core lfds711_freelist_init_valid_on_current_logical_core
-    #define LFDS720_FREELIST_N_SET_VALUE_IN_ELEMENT LFDS711_FREELIST_SET_VALUE_IN_ELEMENT
-    #define LFDS720_FREELIST_N_GET_VALUE_FROM_ELEMENT LFDS711_FREELIST_GET_VALUE_FROM_ELEMENT
-    #define lfds720_freelist_n_threadsafe_push lfds711_freelist_push
-    #define lfds720_freelist_n_threadsafe_pop lfds711_freelist_pop
-    #define lfds720_ringbuffer_n_cleanup lfds711_ringbuffer_cleanup
-    #define lfds720_freelist_n_cleanup lfds711_freelist_cleanup
-    #define lfds720_ringbuffer_n_read lfds711_ringbuffer_read
-    #define lfds720_ringbuffer_n_write lfds711_ringbuffer_write
-    #define lfds720_misc_flag lfds711_misc_flag
-    #define LFDS720_MISC_FLAG_RAISED LFDS711_MISC_FLAG_RAISED
-    #define LFDS720_MISC_MAKE_VALID_ON_CURRENT_LOGICAL_CORE_INITS_COMPLETED_BEFORE_NOW_ON_ANY_OTHER_PHYSICAL_CORE LFDS711_MISC_MAKE_VALID_ON_CURRENT_LOGICAL_CORE_INITS_COMPLETED_BEFORE_NOW_ON_ANY_OTHER_LOGICAL_CORE
-    #define lfds720_pal_uint_t lfds711_pal_uint_t
-#else
-    #include "liblfds720.h"
-#endif
+    //! cache line size in bytes, lock-free queue indexes are padded to it so that fragment / main thread don't share a line
+    #define FBG_CACHE_LINE_SIZE 64
 #endif
+
+    //! number of jobs which can be worked on at the same time by a context pool (extra jobs are run by the submitting thread alone)
+    #define FBG_MAX_JOBS 8
+
+    //! thread affinity : any CPU (but the one reserved with fbg_reserveCore())
+    #define FBG_CPU_ANY -1
+    //! thread affinity : one CPU per thread in turn (skipping the one reserved with fbg_reserveCore())
+    #define FBG_CPU_AUTO -2
 #endif
 
 // ### Library structures
 
+    //! no SIMD instruction sets (portable C code only)
+    #define FBG_SIMD_NONE 0
+    //! x86 SSE2 instruction set
+    #define FBG_SIMD_SSE2 (1 << 0)
+    //! x86 AVX2 instruction set
+    #define FBG_SIMD_AVX2 (1 << 1)
+    //! ARM NEON instruction set
+    #define FBG_SIMD_NEON (1 << 2)
+
+    //! idle detection : none (see fbg_setIdleDetection())
+    #define FBG_IDLE_NONE 0
+    //! idle detection : a frame is unchanged when the calling thread and all fragments reported it with fbg_unchanged()
+    #define FBG_IDLE_EXPLICIT (1 << 0)
+    //! idle detection : a frame is unchanged when the hash of every tile of the back buffer match the presented frame
+    #define FBG_IDLE_HASH (1 << 1)
+    //! pace of unchanged frames (nanoseconds) till the interval between presented frames is known (see fbg_setIdleDetection())
+    #define FBG_IDLE_FRAME_TIME 16666667
+    //! width / height in pixels of the display tiles (dirty tiles, FBG_IDLE_HASH)
+    #define FBG_TILE_SIZE 32
+
+    //! render format : 3 bytes per pixel in R, G, B memory order
+    #define FBG_FORMAT_RGB888 0
+    //! render format : 3 bytes per pixel in B, G, R memory order
+    #define FBG_FORMAT_BGR888 1
+    //! render format : 4 bytes per pixel in R, G, B, X memory order (XBGR8888 32-bit little endian words)
+    #define FBG_FORMAT_RGBX8888 2
+    //! render format : 4 bytes per pixel in B, G, R, X memory order (XRGB8888 32-bit little endian words, the usual 32 bpp framebuffer layout)
+    #define FBG_FORMAT_BGRX8888 3
+
+    //! alignment in bytes of the buffers returned by the default allocator (cache line / widest SIMD registers)
+    #define FBG_BUFFER_ALIGNMENT 64
+    //! huge page size in bytes assumed by the default allocator, FBG_ALLOC_HUGEPAGES buffers size is rounded up to it
+    #define FBG_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+    //! allocation usage : back / display buffers of a context (see fbg_setAllocator())
+    #define FBG_ALLOC_FRAME (1 << 0)
+    //! allocation usage : fragments buffers (buffer pool)
+    #define FBG_ALLOC_FRAGMENT (1 << 1)
+    //! allocation option : back the buffers with huge pages (MAP_HUGETLB, transparent huge pages are requested when none are reserved, Linux only)
+    #define FBG_ALLOC_HUGEPAGES (1 << 8)
+    //! allocation option : lock the buffers in memory (mlock) so that they are never paged out, subject to RLIMIT_MEMLOCK
+    #define FBG_ALLOC_LOCK (1 << 9)
+
     //! RGBA color data structure
     /*! Hold RGBA components [0,255]*/
     struct _fbg_rgb {
@@ -78,6 +105,38 @@
         unsigned char a;
     };
 
+    //! Allocator data structure
+    /*! Hold the functions providing the back / display and fragments buffers of a context (see fbg_setAllocator()) */
+    struct _fbg_allocator {
+        //! return size bytes of zeroed memory aligned to FBG_BUFFER_ALIGNMENT at least (NULL on failure), flags hold the FBG_ALLOC_* usage and the options enabled for the context
+        void *(*alloc)(size_t size, int flags, void *user_data);
+        //! free a buffer returned by alloc, size and flags are the ones given to alloc
+        void (*free)(void *buffer, size_t size, int flags, void *user_data);
+        //! user data given to the functions
+        void *user_data;
+    };
+
+    //! Kernels data structure
+    /*! Hold buffer processing functions selected at setup time from the available SIMD instruction sets, all variants give identical results */
+    struct _fbg_kernels {
+        //! saturated additive mixing of size bytes of src into dst
+        void (*additive)(unsigned char *dst, const unsigned char *src, int size);
+        //! saturated subtraction of size bytes of src from dst
+        void (*subtract)(unsigned char *dst, const unsigned char *src, int size);
+        //! alpha blending of size bytes of src over dst : (alpha * src + (255 - alpha) * dst) >> 8
+        void (*alpha)(unsigned char *dst, const unsigned char *src, int size, int alpha);
+        //! maximum of size bytes of src and dst
+        void (*max)(unsigned char *dst, const unsigned char *src, int size);
+        //! multiply blending of size bytes of src and dst : src * dst / 255
+        void (*multiply)(unsigned char *dst, const unsigned char *src, int size);
+        //! screen blending of size bytes of src and dst : 255 - (255 - src) * (255 - dst) / 255
+        void (*screen)(unsigned char *dst, const unsigned char *src, int size);
+        //! copy src pixels (3 or 4 components) to dst, src pixels with a RGB value equal to key are skipped
+        void (*colorkey)(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key);
+        //! alpha blending of src pixels (3 or 4 components) over dst, src pixels with a RGB value equal to key are skipped
+        void (*alphaColorkey)(unsigned char *dst, const unsigned char *src, int size, int components, struct _fbg_rgb key, int alpha);
+    };
+
     //! HSL color data structure
     /*! Hold HSL components S/L [0,1], HUE [0, 360]*/
     struct _fbg_hsl {
@@ -98,6 +157,23 @@
         unsigned int height;
     };
 
+    struct _fbg;
+
+    //! Raster primitives data structure
+    /*! Hold drawing functions specialized for the context components count (3 or 4), selected at setup time, colors are given in the render format and the dirty area is handled by the callers */
+    struct _fbg_primitives {
+        //! fill a rectangle with a color (4 components : 32 bits stores)
+        void (*rect)(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b);
+        //! blend a color over a rectangle
+        void (*recta)(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+        //! substract (up = 0) or add (up = 1) an amount to all the components of the display
+        void (*fade)(struct _fbg *fbg, unsigned char amount, int up);
+        //! draw an image, pixels with a RGB value equal to the key are skipped
+        void (*imageColorkey)(struct _fbg *fbg, struct _fbg_img *img, int x, int y, int cr, int cg, int cb);
+        //! draw a scaled image area (see fbg_imageEx())
+        void (*imageEx)(struct _fbg *fbg, struct _fbg_img *img, int x, int y, float sx, float sy, int cx, int cy, int cw, int ch);
+    };
+
     //! Bitmap font data structure
     /*! Hold bitmap font informations and associated image */
     struct _fbg_font {
@@ -118,6 +194,309 @@
         struct _fbg_img *bitmap;
     };
 
+#ifdef FBG_PARALLEL
+    //! Synchronization value data structure
+    /*! Hold a value threads can wait on, waiting threads spin then sleep (see fbg_setWaitSpin()) */
+    struct _fbg_sync {
+        //! synchronization value
+        atomic_int value;
+        //! number of threads sleeping on the value
+        atomic_int sleepers;
+    };
+
+    //! Fragments barrier data structure
+    /*! Wait till all fragments completed their frame */
+    struct _fbg_barrier {
+        //! number of fragments
+        int count;
+        //! number of fragments which reached the barrier
+        atomic_int arrived;
+        //! barrier generation, incremented when all fragments reached the barrier
+        struct _fbg_sync generation;
+    };
+
+    //! Task group data structure
+    /*! Track the jobs submitted with fbg_parallelForAsync(), see fbg_initTaskGroup() and fbg_waitTaskGroup() */
+    struct _fbg_task_group {
+        //! number of submitted jobs which are not completed yet
+        atomic_int pending;
+    };
+
+    //! Parallel job data structure
+    /*! Hold a job split into work items which are claimed (atomically) by the submitting thread, idle fragments threads and workers threads */
+    struct _fbg_job {
+        //! job function, called once for each work item
+        void (*fn)(struct _fbg_job *job, int index);
+        //! job data
+        void *data;
+        //! number of work items
+        int count;
+
+        //! context given to the range function
+        struct _fbg *fbg;
+        //! range function, called with a part of the range for each work item (fbg_parallelFor())
+        void (*range_fn)(struct _fbg *fbg, int begin, int end, void *user_data);
+        //! range start
+        int begin;
+        //! range end (excluded)
+        int end;
+        //! number of range values per work item
+        int grain;
+
+        //! group the job belong to
+        struct _fbg_task_group *group;
+
+        //! 1 while the job slot is taken
+        atomic_int used;
+        //! next work item to claim
+        atomic_int next;
+        //! number of completed work items
+        atomic_int done;
+        //! 1 when helper threads are allowed to join the job
+        atomic_int active;
+        //! number of helper threads currently inside the job
+        atomic_int helpers;
+    };
+
+    //! Thread pool data structure
+    /*! Hold the jobs of a FBG context and its workers threads, shared with the fragments contexts and other FBG contexts (see fbg_sharePool()) */
+    struct _fbg_pool {
+        //! jobs slots
+        struct _fbg_job jobs[FBG_MAX_JOBS];
+        //! first slot looked at by the next thread looking for work (rotate so that all jobs get threads)
+        atomic_uint next_job;
+
+        //! incremented when a job is submitted (idle workers sleep on it)
+        struct _fbg_sync submitted;
+        //! incremented when a job is completed (threads waiting on a task group sleep on it)
+        struct _fbg_sync completed;
+
+        //! workers threads
+        pthread_t *workers;
+        //! number of workers threads
+        int workers_count;
+        //! workers running state (FBG_FRAGMENT_RUNNING or FBG_FRAGMENT_STOPPED)
+        atomic_int state;
+        //! time in microseconds workers spin before sleeping (see fbg_setWaitSpin())
+        atomic_int wait_spin;
+
+        //! number of FBG contexts using the pool, it is freed with the last one
+        atomic_int references;
+        //! 1 once shared by several FBG contexts, fragments created afterwards are run by the pool threads
+        int shared;
+    };
+
+    //! Pooled buffer data structure
+    /*! Hold a buffer of the buffer pool */
+    struct _fbg_pooled_buffer {
+        //! buffer data
+        unsigned char *buffer;
+        //! allocated size of the buffer (its size class, bytes)
+        size_t size;
+        //! 1 while borrowed by a fragment
+        int used;
+        //! allocator which provided the buffer, it is freed with it
+        struct _fbg_allocator allocator;
+        //! allocation options of the buffer
+        int alloc_options;
+    };
+
+    //! Buffer pool data structure
+    /*! Hold the fragments buffers of a FBG context (and of the contexts sharing its thread pool, see fbg_sharePool()) by size class, fragments borrow their buffers from it when created / reconfigured and give them back when freed so that buffers are reused and their total size capped (see fbg_setBufferPoolLimit()) */
+    struct _fbg_buffer_pool {
+        //! pooled buffers
+        struct _fbg_pooled_buffer *buffers;
+        //! number of pooled buffers
+        int count;
+        //! length of the pooled buffers array
+        int capacity;
+
+        //! total size of the pooled buffers (bytes)
+        size_t allocated;
+        //! total size of the borrowed buffers (bytes)
+        size_t used;
+        //! highest total size of the pooled buffers (bytes)
+        size_t peak;
+        //! maximum total size of the pooled buffers (bytes, 0 = unlimited)
+        size_t limit;
+
+        //! allocator providing new buffers (the one of the last context which called fbg_setAllocator())
+        struct _fbg_allocator allocator;
+        //! allocation options of new buffers
+        int alloc_options;
+
+        //! number of FBG contexts using the pool, it is freed with the last one
+        atomic_int references;
+        //! serialize accesses of the contexts sharing the pool
+        pthread_mutex_t mutex;
+    };
+
+    //! Buffer pool statistics data structure
+    /*! Hold a snapshot of the buffer pool counters (see fbg_getBufferPoolStats()) */
+    struct _fbg_buffer_pool_stats {
+        //! total size of the pooled buffers (bytes)
+        size_t allocated;
+        //! total size of the buffers borrowed by fragments (bytes)
+        size_t used;
+        //! highest total size of the pooled buffers (bytes)
+        size_t peak;
+        //! maximum total size of the pooled buffers (bytes, 0 = unlimited)
+        size_t limit;
+        //! number of pooled buffers
+        int buffers;
+        //! number of pooled buffers not borrowed by fragments
+        int free_buffers;
+    };
+
+    //! Adaptive fragments decisions (see fbg_getAdaptiveStats())
+    enum _fbg_adaptive_decision {
+        //! the fragments count was kept
+        FBG_ADAPTIVE_KEEP = 0,
+        //! a fragment was added (frames over the target time and fragments are the bottleneck)
+        FBG_ADAPTIVE_GROW,
+        //! a fragment was removed (frames would still fit the target time or mixing is the bottleneck)
+        FBG_ADAPTIVE_SHRINK
+    };
+
+    //! Adaptive fragments statistics data structure
+    /*! Hold the last adaptive fragments decision and the average times measured over its window (see fbg_getAdaptiveStats()) */
+    struct _fbg_adaptive_stats {
+        //! current number of fragments
+        int tasks;
+        //! last decision (one of FBG_ADAPTIVE_*)
+        int decision;
+        //! number of evaluated windows
+        uint64_t windows;
+        //! number of times the fragments count was changed
+        uint64_t changes;
+        //! average time between two fbg_flip() calls (nanoseconds)
+        uint64_t frame_time;
+        //! average time a fragment spent drawing a frame (nanoseconds)
+        uint64_t render_time;
+        //! average time fbg_draw() spent mixing (nanoseconds)
+        uint64_t mixing_time;
+        //! average time spent in the backend flip (nanoseconds)
+        uint64_t flip_time;
+    };
+
+    //! Adaptive fragments data structure
+    /*! Hold the adaptive fragments count settings and the times measured over the current window (see fbg_setAdaptiveFragments()) */
+    struct _fbg_adaptive {
+        //! target frame time (nanoseconds, 0 = disabled)
+        uint64_t target_time;
+        //! minimum number of fragments
+        int min_tasks;
+        //! maximum number of fragments
+        int max_tasks;
+        //! number of frames of a window
+        int window;
+
+        //! number of frames measured in the current window
+        int frames;
+        //! time of the last fbg_flip() call (nanoseconds, 0 = none since the window start)
+        uint64_t last_flip;
+        //! time between fbg_flip() calls accumulated over the current window (nanoseconds)
+        uint64_t frame_time;
+        //! mixing time accumulated over the current window (nanoseconds)
+        uint64_t mixing_time;
+        //! flip time accumulated over the current window (nanoseconds)
+        uint64_t flip_time;
+        //! fragments drawing time at the window start (nanoseconds)
+        uint64_t render_time;
+        //! fragments frames count at the window start
+        uint64_t render_frames;
+
+        //! last decision
+        struct _fbg_adaptive_stats stats;
+    };
+#endif
+
+    //! Bounding box data structure
+    /*! Hold an area of a buffer in pixels (x2 / y2 excluded), the box is empty when x2 <= x1 or y2 <= y1 */
+    struct _fbg_bbox {
+        //! left
+        int x1;
+        //! top
+        int y1;
+        //! right (excluded)
+        int x2;
+        //! bottom (excluded)
+        int y2;
+    };
+
+    //! Region data structure
+    /*! Hold the position of a context drawing area within the display, fragments only draw a part of the display in split rendering mode (see fbg_setFragmentSplit()) */
+    struct _fbg_region {
+        //! X position of the area in pixels
+        int x;
+        //! Y position of the area first row in pixels
+        int y;
+        //! Number of display rows between two consecutive rows of the area (> 1 with FBG_SPLIT_ROWS)
+        int row_step;
+        //! Whole display width in pixels
+        int display_width;
+        //! Whole display height in pixels
+        int display_height;
+    };
+
+    //! Dirty tiles data structure
+    /*! Hold bitmaps of the display tiles (one bit per FBG_TILE_SIZE tile, rows of row_words 32 bits words) touched by the drawing functions and changed by the presented frames (see fbg_setDirtyTiles()) */
+    struct _fbg_tiles {
+        //! tiles touched since the last fbg_clear()
+        uint32_t *touched;
+        //! tiles touched by the last presented frame
+        uint32_t *presented;
+        //! tiles changed by the frames presented since the last fbg_getPresentRects() call
+        uint32_t *pending;
+        //! number of tiles per row
+        int tiles_x;
+        //! number of tiles rows
+        int tiles_y;
+        //! number of 32 bits words per bitmap row
+        int row_words;
+        //! 1 when the whole display must be presented (first frame, resize)
+        int full;
+        //! areas returned by fbg_getPresentRects()
+        struct _fbg_bbox *rects;
+        //! rects of the previous / current tiles row which may be extended downward (fbg_getPresentRects() merging)
+        int *active;
+    };
+
+    //! Idle detection data structure
+    /*! Hold the unchanged frames detection state of a FBG context (see fbg_setIdleDetection()) */
+    struct _fbg_idle {
+        //! detection modes (FBG_IDLE_* flags)
+        int mode;
+        //! number of consecutive unchanged frames after which fragments are parked (0 = never)
+        int park_frames;
+        //! number of consecutive unchanged frames (not presented)
+        int frames;
+        //! total number of unchanged frames
+        uint64_t skipped;
+        //! 1 while fragments are parked (see fbg_wake())
+        int parked;
+        //! 1 when fbg_unchanged() was called since the last frame
+        int unchanged;
+        //! 1 when fbg_draw() skipped mixing of an unchanged frame (FBG_IDLE_EXPLICIT)
+        int skip;
+        //! 1 when the last fbg_flip() presented its frame, fbg_draw() does not call the backend draw function otherwise
+        int presented;
+        //! average interval between consecutive presented frames (nanoseconds, 0 = unknown), unchanged frames are paced with it
+        uint64_t frame_time;
+        //! time of the last presented frame (nanoseconds)
+        uint64_t presented_time;
+        //! time the next unchanged frame is due (nanoseconds)
+        uint64_t next_frame;
+        //! hash of the presented frame tiles followed by the hash of the back buffer tiles (FBG_IDLE_HASH)
+        uint64_t *tiles_hash;
+        //! number of tiles per row
+        int tiles_x;
+        //! number of tiles rows
+        int tiles_y;
+        //! 1 when tiles_hash hold the presented frame hashes
+        int hashed;
+    };
+
     //! FB Graphics context data structure
     /*! Hold all data related to a FBG context */
     struct _fbg {
@@ -173,8 +552,23 @@
         //! Offset to add in case of 32 BPP
         int comp_offset;
         //! Internal buffers line length
+        /*! Distance in bytes between two rows, may be larger than width * components for fragments in split rendering mode */
         int line_length;
 
+        //! Drawing area position within the display
+        struct _fbg_region region;
+
+        //! Bounding box of the pixels touched by the drawing functions since the last fbg_clear() (when dirty_tracking is enabled, see fbg_setDirtyTracking())
+        struct _fbg_bbox dirty;
+        //! 1 when drawing functions update the dirty bounding box
+        int dirty_tracking;
+
+        //! Display tiles touched by the drawing functions, NULL when disabled (see fbg_setDirtyTiles())
+        struct _fbg_tiles *dirty_tiles;
+
+        //! Unchanged frames detection (see fbg_setIdleDetection())
+        struct _fbg_idle idle;
+
         //! Requested new display width (resize event)
         int new_width;
         //! Requested new display height (resize event)
@@ -198,9 +592,31 @@
         //! Frame counter for the current second
         int frame;
 
-        //! Flag indicating a BGR framebuffer
+        //! Render format of the buffers (FBG_FORMAT_*, see fbg_setFormat())
+        int format;
+
+        //! Flag indicating a BGR ordered render format (drawing functions swap the red and blue components)
         int bgr;
 
+        //! SIMD instruction sets in use (FBG_SIMD_* flags)
+        /*! Detected by fbg_customSetup(), see fbg_setSIMD() */
+        int simd;
+
+        //! Buffer processing kernels selected for the SIMD instruction sets in use
+        struct _fbg_kernels kernels;
+
+        //! Raster primitives selected for the context components count
+        struct _fbg_primitives primitives;
+
+        //! Allocator of the back / display and fragments buffers (see fbg_setAllocator())
+        struct _fbg_allocator allocator;
+
+        //! FBG_ALLOC_HUGEPAGES / FBG_ALLOC_LOCK options of the back / display and fragments buffers
+        int alloc_options;
+
+        //! Alignment in bytes of the back / display buffers rows (see fbg_setRowAlignment())
+        int row_alignment;
+
         //! Backend resize function
         void (*backend_resize)(struct _fbg *fbg, unsigned int new_width, unsigned int new_height);
         //! User-defined resize function
@@ -228,7 +644,7 @@
         struct _fbg_fragment **fragments;
 
         //! FBG synchronization barrier
-        pthread_barrier_t *sync_barrier;
+        struct _fbg_barrier *sync_barrier;
 
         //! Task id associated to that FBG context
         int task_id;
@@ -236,50 +652,312 @@
         //! FBG context running state
         atomic_int state;
 
-        //! Ringbuffer queue length (1 by default, best settings with sync. since we just wait till all threads finish)
+        //! Number of buffers per fragment (7 by default with FBG_LFDS, 2 otherwise so that fragments can draw the next frame while the current one is mixed, see fbg_setFragmentQueueSize())
         //! Note : This settings may have an impact on feedback effects (since it will pick sequentially buffers from the list, thus allowing a number of "past" rendered frame which may not be what you want with regular feedback effects but also may be what you want for other effects like unlimited blobs...)
         unsigned int fragment_queue_size;
+
+        //! Built-in mixing settings indexed by task id (see fbg_setMixing())
+        struct _fbg_mixing *mixing;
+        //! Length of the mixing settings array
+        int mixing_count;
+
+        //! Fragments threads settings indexed by task id, 0 being the default one (see fbg_setFragmentAffinity())
+        struct _fbg_thread_settings *thread_settings;
+        //! Length of the threads settings array
+        int thread_settings_count;
+        //! CPU reserved for the calling thread (-1 = none, see fbg_reserveCore())
+        int reserved_cpu;
+
+        //! Number of horizontal stripes fbg_draw() mixing is split into (0 = serial mixing on the calling thread, see fbg_setMixingStripes())
+        int mixing_stripes;
+
+        //! Thread pool of the main FBG context (parallel mixing, fbg_parallelFor()), shared with the fragments contexts
+        struct _fbg_pool *pool;
+
+        //! Buffer pool fragments buffers are borrowed from (see fbg_setBufferPoolLimit())
+        struct _fbg_buffer_pool *buffer_pool;
+
+        //! 1 when fragments are run by the pool threads (see fbg_sharePool())
+        int fragments_pooled;
+        //! Pooled fragments frame job
+        struct _fbg_task_group fragments_group;
+
+        //! Minimum time between two fbg_flip() calls (nanoseconds, 0 = none, see fbg_setFramePacing())
+        uint64_t frame_pacing;
+        //! Time of the next paced fbg_flip() call (nanoseconds)
+        uint64_t next_flip;
+
+        //! Time in microseconds threads spin before sleeping when waiting on each other (-1 = never sleep, see fbg_setWaitSpin())
+        atomic_int wait_spin;
+
+        //! Split rendering mode applied by fbg_createFragment() (see fbg_setFragmentSplit())
+        int split_mode;
+        //! Number of tiles columns for FBG_SPLIT_TILES (0 = automatic)
+        int split_columns;
+
+        //! Which fragments buffers are mixed by fbg_draw() (see fbg_setDrawPolicy())
+        int draw_policy;
+
+        //! Adaptive fragments count settings and measures (see fbg_setAdaptiveFragments())
+        struct _fbg_adaptive adaptive;
 #endif
     };
 
 #ifdef FBG_PARALLEL
+    //! Built-in mixing modes (see fbg_setMixing())
+    enum _fbg_mixing_mode {
+        //! saturated addition (default)
+        FBG_MIXING_ADDITIVE = 0,
+        //! alpha blending with the task alpha value
+        FBG_MIXING_ALPHA,
+        //! alpha blending with the task alpha value, pixels matching the task colorkey are skipped
+        FBG_MIXING_ALPHA_COLORKEY,
+        //! maximum of both buffers (per component)
+        FBG_MIXING_MAX,
+        //! multiply blending
+        FBG_MIXING_MULTIPLY,
+        //! screen blending
+        FBG_MIXING_SCREEN,
+        //! copy, pixels matching the task colorkey are skipped
+        FBG_MIXING_COLORKEY,
+        //! opaque copy
+        FBG_MIXING_COPY
+    };
+
+    //! Mixing settings data structure
+    /*! Hold the built-in mixing settings of a task */
+    struct _fbg_mixing {
+        //! mixing mode
+        enum _fbg_mixing_mode mode;
+        //! alpha value [0,255] used by FBG_MIXING_ALPHA*
+        int alpha;
+        //! RGB colorkey used by FBG_MIXING_*COLORKEY (default to black)
+        struct _fbg_rgb colorkey;
+    };
+
+    //! Thread settings data structure
+    /*! Hold the affinity / scheduling settings of a fragment (or workers) thread */
+    struct _fbg_thread_settings {
+        //! CPU the thread run on, FBG_CPU_ANY (default) or FBG_CPU_AUTO
+        int cpu;
+        //! scheduling policy (SCHED_OTHER by default, SCHED_FIFO or SCHED_RR)
+        int policy;
+        //! scheduling priority (0 with SCHED_OTHER, 1 to 99 otherwise)
+        int priority;
+        //! thread stack size in bytes (0 = system default)
+        size_t stack_size;
+    };
+
+    //! Split rendering modes (see fbg_setFragmentSplit())
+    enum _fbg_split_mode {
+        //! each fragment draw into its own full display buffer which is mixed by fbg_draw() (default)
+        FBG_SPLIT_NONE = 0,
+        //! each fragment draw an horizontal band of the display back buffer
+        FBG_SPLIT_BANDS,
+        //! each fragment draw interleaved rows of the display back buffer (one row out of fragments count)
+        FBG_SPLIT_ROWS,
+        //! each fragment draw a tile of the display back buffer
+        FBG_SPLIT_TILES,
+        //! a single fragment draw the whole display back buffer (pass-through), several fragments are mixed as with FBG_SPLIT_NONE
+        FBG_SPLIT_PASSTHROUGH
+    };
+
+    //! fbg_draw() policies (see fbg_setDrawPolicy())
+    enum _fbg_draw_policy {
+        //! mix the oldest buffer of each fragment (default)
+        FBG_DRAW_QUEUE = 0,
+        //! mix the newest buffer of each fragment, older buffers are dropped
+        FBG_DRAW_NEWEST,
+        //! mix buffers of the same frame sequence number, buffers of older frames are dropped
+        FBG_DRAW_MATCHING,
+        //! never wait, mix the most recent frame completed by each fragment (the last one again if there is none), fragments don't wait on each other
+        FBG_DRAW_LATEST
+    };
+
+    //! Fragment frame data structure
+    /*! Hold the tag of a frame pushed by a fragment */
+    struct _fbg_frame_info {
+        //! frame sequence number (fragment frames counter, frames with the same sequence number were drawn in the same pass by all fragments)
+        uint64_t sequence;
+        //! time at which the frame was completed (nanoseconds, CLOCK_MONOTONIC)
+        uint64_t timestamp;
+        //! area of the buffer touched by the fragment, the rest is black (whole buffer without dirty tracking)
+        struct _fbg_bbox dirty;
+        //! 1 when the fragment reported the frame as identical to its previous one (see fbg_unchanged())
+        int unchanged;
+    };
+
+    //! Fragment statistics data structure
+    /*! Hold a snapshot of a fragment counters (see fbg_getFragmentStats()) */
+    struct _fbg_fragment_stats {
+        //! number of frames produced by the fragment
+        uint64_t frames;
+        //! total time the fragment waited for its buffer to be consumed (nanoseconds)
+        uint64_t wait_time;
+        //! number of times the fragment went to sleep while waiting for its buffer to be consumed
+        uint64_t wait_sleeps;
+        //! total time fbg_draw() waited for the fragment (nanoseconds)
+        uint64_t draw_wait_time;
+        //! number of times fbg_draw() went to sleep while waiting for the fragment
+        uint64_t draw_wait_sleeps;
+        //! number of frames overwritten by the fragment before fbg_draw() got them (FBG_LFDS)
+        uint64_t overwrites;
+        //! number of frames dropped by fbg_draw() (see fbg_setDrawPolicy())
+        uint64_t drops;
+        //! number of fbg_draw() calls which mixed the previous frame again (FBG_DRAW_LATEST)
+        uint64_t reuses;
+        //! total time the fragment spent drawing (user fragment function, nanoseconds)
+        uint64_t render_time;
+        //! number of buffers of the fragment (lower than the queue size when the buffer pool limit was reached, see fbg_setBufferPoolLimit())
+        int buffers;
+        //! sequence number of the frame mixed by the last fbg_draw() call
+        uint64_t sequence;
+        //! completion time of the frame mixed by the last fbg_draw() call (nanoseconds, CLOCK_MONOTONIC)
+        uint64_t timestamp;
+    };
+
+    //! Parallel mixing data structure
+    /*! Hold the fbg_draw() mixing job data when mixing is split into stripes (see fbg_setMixingStripes()) */
+    struct _fbg_mixing_stripes {
+        //! main FBG context
+        struct _fbg *fbg;
+        //! mixing function
+        void (*user_mixing)(struct _fbg *fbg, unsigned char *buffer, int task_id);
+        //! height of a stripe in pixels
+        int stripe_height;
+    };
+
 #ifdef FBG_LFDS
     //! Freelist data structure
     /*! Hold pre-allocated data associated with a task */
     struct _fbg_freelist_data {
-        struct lfds720_freelist_n_element freelist_element;
+        //! 1 when the buffer is in the freelist
+        _Alignas(FBG_CACHE_LINE_SIZE) atomic_int free;
 
         unsigned char *buffer;
+
+        //! Frame held by the buffer
+        struct _fbg_frame_info frame;
+    };
+
+    //! Ringbuffer data structure
+    /*! Lock-free single producer (fragment) / single consumer (fbg_draw()) ring of buffers, the oldest buffer is overwritten when the ring is full */
+    struct _fbg_ringbuffer {
+        //! Next slot written by the fragment
+        _Alignas(FBG_CACHE_LINE_SIZE) atomic_uint write_index;
+        //! Incremented on each write (fbg_draw() wait on it)
+        struct _fbg_sync written;
+
+        //! Next slot read by fbg_draw() (also advanced by the fragment when it overwrite the oldest buffer)
+        _Alignas(FBG_CACHE_LINE_SIZE) atomic_uint read_index;
+
+        //! Incremented each time a buffer is put back into the freelist (the fragment wait on it)
+        _Alignas(FBG_CACHE_LINE_SIZE) struct _fbg_sync freed;
+
+        //! Number of slots
+        _Alignas(FBG_CACHE_LINE_SIZE) unsigned int size;
+        //! Slots
+        struct _fbg_freelist_data *_Atomic *slots;
+    };
+#endif
+
+    //! Fragment running states
+    enum _fbg_fragment_state {
+        //! terminated (the thread exit)
+        FBG_FRAGMENT_STOPPED = 0,
+        //! drawing frames
+        FBG_FRAGMENT_RUNNING,
+        //! waiting at the start of its loop while its context and buffers are changed (see fbg_reconfigureFragments())
+        FBG_FRAGMENT_PARKED
     };
-  #endif
 
     //! Task (fragment) data structure
     /*! Hold a task data */
     struct _fbg_fragment {
-        //! Fragment running state
+        //! Fragment running state (one of FBG_FRAGMENT_*)
         atomic_int state;
+        //! 1 while the fragment is parked
+        struct _fbg_sync parked;
+        //! 1 when the user data must be recreated once the fragment is resumed (user functions changed)
+        int restart;
+        //! 1 when the fragment must clear its reused buffers once resumed
+        int clear_buffers;
 
         //! Task own FBG context
         struct _fbg *fbg;
 
 #ifdef FBG_LFDS
-        //! Ringbuffer element
-        struct lfds720_ringbuffer_n_element *ringbuffer_element;
-        //! Ringbuffer state
-        struct lfds720_ringbuffer_n_state *ringbuffer_state;
-
-        //! Freelist state
-        struct lfds720_freelist_n_state *freelist_state;
+        //! Ringbuffer
+        struct _fbg_ringbuffer *ringbuffer;
 
-        //! Pre-allocated tasks data
+        //! Pre-allocated tasks data (the freelist)
         struct _fbg_freelist_data *fbg_freelist_data;
+        //! Number of pre-allocated tasks data
+        int freelist_size;
 
         //! Temporary task data
         struct _fbg_freelist_data *tmp_fbg_freelist_data; 
 #endif
 
-        //! thread <> main thread synchronization
-        atomic_int sync_wait;
+        //! Fragment buffers used in turn (NULL with FBG_LFDS or in split rendering mode)
+        unsigned char **buffers;
+        //! Number of fragment buffers (1 in split rendering mode, 0 with FBG_LFDS)
+        int buffers_count;
+        //! Allocated size of each fragment buffers (bytes), they are reused by fbg_reconfigureFragments() when large enough
+        int buffers_size;
+        //! thread <> main thread synchronization, one per buffer (1 = buffer ready to be mixed, 0 = free)
+        struct _fbg_sync *sync_wait;
+        //! Next buffer written by the fragment
+        int write_index;
+        //! Next buffer read by fbg_draw()
+        int read_index;
+        //! Frame held by each fragment buffers
+        struct _fbg_frame_info *buffers_frame;
+
+        //! Number of frames produced by the fragment
+        atomic_uint_fast64_t frames;
+        //! Time the fragment waited for its buffer to be consumed (nanoseconds)
+        atomic_uint_fast64_t wait_time;
+        //! Number of times the fragment went to sleep while waiting for its buffer to be consumed
+        atomic_uint_fast64_t wait_sleeps;
+        //! Time fbg_draw() waited for the fragment (nanoseconds)
+        atomic_uint_fast64_t draw_wait_time;
+        //! Number of times fbg_draw() went to sleep while waiting for the fragment
+        atomic_uint_fast64_t draw_wait_sleeps;
+        //! Number of frames overwritten by the fragment before fbg_draw() got them
+        atomic_uint_fast64_t overwrites;
+        //! Number of frames dropped by fbg_draw()
+        atomic_uint_fast64_t drops;
+        //! Number of fbg_draw() calls which mixed the previous frame again
+        atomic_uint_fast64_t reuses;
+        //! Time the fragment spent drawing (nanoseconds)
+        atomic_uint_fast64_t render_time;
+
+        //! 1 when the fragment has no thread and its frames are run by the pool threads (see fbg_sharePool())
+        int pooled;
+        //! 1 once the user data of a pooled fragment is created
+        int started;
+        //! User-defined task end function matching the user data of a pooled fragment
+        void (*started_stop)(struct _fbg *fbg, void *user_data);
+
+        //! Thread pool of the main FBG context the fragment help with while idle
+        struct _fbg_pool *pool;
+        //! Buffer pool the fragment buffers are borrowed from
+        struct _fbg_buffer_pool *buffer_pool;
+
+        //! Main FBG context back buffer the fragment draw into (split rendering mode, NULL otherwise)
+        unsigned char **shared_buffer;
+        //! Offset of the fragment area in the shared back buffer
+        int shared_offset;
+
+        //! Fragment buffer being mixed by fbg_draw()
+        unsigned char *mixing_buffer;
+        //! Frame held by the mixing buffer
+        struct _fbg_frame_info mixing_frame;
+#ifdef FBG_LFDS
+        //! Task data associated with the mixing buffer
+        struct _fbg_freelist_data *mixing_data;
+#endif
 
         //! User-defined task start function
         void *(*user_fragment_start)(struct _fbg *fbg);
@@ -295,6 +973,13 @@
 
 // ### Library functions
 
+    //! storage of the hot primitives (fbg_pixel(), fbg_rect() etc.) : static inline in the including code when FBG_INLINE is defined (so that the compiler can inline and vectorize them within drawing loops), provided by fbgraphics.c otherwise
+#ifdef FBG_INLINE
+    #define _FBG_INLINE_API static inline
+#else
+    #define _FBG_INLINE_API extern
+#endif
+
     //! initialize a FB Graphics context (typically used by a custom rendering backend)
     /*!
       \param width render width
@@ -330,6 +1015,7 @@
     //! resize the FB Graphics context immediately
     //! note : prefer the usage of fbg_pushResize when integrating the resize event of a custom backend (fbg_pushResize is thread safe all the time)
     //! note : resizing is not yet allowed in framebuffer mode
+    //! note : fragments are resized in place (see fbg_reconfigureFragments()), they keep their user data
     /*!
       \param fbg pointer to a FBG context / data structure
       \param new_width new render width
@@ -350,6 +1036,85 @@
     */
     extern void fbg_pushResize(struct _fbg *fbg, int new_width, int new_height);
 
+    //! restrict the SIMD instruction sets used by the context kernels (mixing etc.)
+    //! note : instruction sets not supported by the CPU are ignored, FBG_SIMD_NONE select the portable C kernels
+    //! note : fragments created afterward inherit the selected kernels
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param simd FBG_SIMD_* flags
+      \return the FBG_SIMD_* flags actually in use
+      \sa fbg_customSetup()
+    */
+    extern int fbg_setSIMD(struct _fbg *fbg, int simd);
+
+    //! set the render format of the context so that drawing functions and image loaders write the display native component order, the backend can then present the buffers as they are
+    //! note : colors are still given as r, g, b to the drawing functions, fbg_getPixel() return them the same way
+    //! note : with 4 components the X (padding) component is set to 0 by every color drawing function (solid or blended), image functions copy the image 4th component and fbg_clear() / fades / mixing process it as the other components
+    //! note : the format must have as many components as the context and should be set before drawing anything or loading images (fbg_fill() colors are stored in the render format), fragments created afterward inherit it
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param format FBG_FORMAT_* constant (FBG_FORMAT_RGB888 or FBG_FORMAT_RGBX8888 by default)
+      \return 1 on success, 0 if the format does not match the context components
+      \sa fbg_customSetup()
+    */
+    extern int fbg_setFormat(struct _fbg *fbg, int format);
+
+    //! set the allocator providing the back / display and fragments buffers of the context and the options of these allocations
+    //! note : the default allocator return FBG_BUFFER_ALIGNMENT aligned buffers, with FBG_ALLOC_HUGEPAGES they are mapped with MAP_HUGETLB (transparent huge pages are requested when the system has no huge pages reserved) and their size is rounded up to FBG_HUGE_PAGE_SIZE
+    //! note : FBG_ALLOC_LOCK buffers are locked with mlock (a failure only print a warning, see RLIMIT_MEMLOCK), this apply to any allocator
+    //! note : the back / display buffers owned by the context are allocated again (and cleared), it must be called before fbg_createFragment()
+    //! note : contexts sharing a buffer pool (see fbg_sharePool()) get their fragments buffers from the allocator of the last context which called it
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param allocator allocator functions (copied), NULL for the default allocator
+      \param options FBG_ALLOC_HUGEPAGES / FBG_ALLOC_LOCK flags (0 for none)
+      \return 1 on success, 0 on failure (the previous allocator is kept)
+      \sa fbg_allocBuffer(), fbg_setRowAlignment()
+    */
+    extern int fbg_setAllocator(struct _fbg *fbg, struct _fbg_allocator *allocator, int options);
+
+    //! allocate a zeroed buffer with the context allocator and options (typically used by a custom rendering backend)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param size size of the buffer in bytes
+      \param usage FBG_ALLOC_FRAME or FBG_ALLOC_FRAGMENT
+      \return buffer pointer, NULL on failure
+      \sa fbg_freeBuffer(), fbg_setAllocator()
+    */
+    extern unsigned char *fbg_allocBuffer(struct _fbg *fbg, size_t size, int usage);
+
+    //! free a buffer allocated with fbg_allocBuffer()
+    //! note : the allocator and options must not have changed in between
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param buffer buffer pointer (NULL is ignored)
+      \param size size of the buffer in bytes, as given to fbg_allocBuffer()
+      \param usage usage given to fbg_allocBuffer()
+      \sa fbg_allocBuffer()
+    */
+    extern void fbg_freeBuffer(struct _fbg *fbg, unsigned char *buffer, size_t size, int usage);
+
+    //! allocate the back / display buffers of a context which was set up without initialize_buffers, the context then owns them (they are freed by fbg_close())
+    //! note : for backends which only know whether they provide the buffers themselves after fbg_customSetup() (fbdev without page flipping)
+    //! note : it must be called before fbg_createFragment()
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \return 1 on success, 0 on failure
+      \sa fbg_customSetup(), fbg_allocBuffer()
+    */
+    extern int fbg_allocDisplayBuffers(struct _fbg *fbg);
+
+    //! pad the rows of the back / display buffers so that each row start at a multiple of alignment bytes (line_length), row based SIMD kernels then always start on aligned data
+    //! note : only for contexts owning their buffers, the buffers are allocated again (and cleared), it must be called before fbg_createFragment() and the setting is kept by fbg_resize()
+    //! note : the backend must present the rows with the context line_length (fbdev does), fbg->size become line_length * height
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param alignment rows alignment in bytes (power of two, 0 or 1 for unpadded rows)
+      \return 1 on success, 0 on failure
+      \sa fbg_setAllocator()
+    */
+    extern int fbg_setRowAlignment(struct _fbg *fbg, int alignment);
+
     //! background fade to black with controllable factor
     /*!
       \param fbg pointer to a FBG context / data structure
@@ -374,6 +1139,82 @@
     */
     extern void fbg_clear(struct _fbg *fbg, unsigned char brightness);
 
+    //! enable / disable tracking of the area touched by the drawing functions (fbg->dirty bounding box), fbg_clear() with a brightness of 0 reset it
+    //! note : in fragments the area is attached to each frame and fbg_draw() only mix the touched area when the mixing allow it (additive, max, screen and colorkey modes with a black colorkey), the rest of the buffer is assumed black
+    //! note : fragments writing into fbg->back_buffer directly must report the area with fbg_dirty(), the setting is given to fragments by fbg_createFragment()
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param enable 1 to enable, 0 to disable (default)
+      \sa fbg_dirty(), fbg_getFragmentDirty()
+    */
+    extern void fbg_setDirtyTracking(struct _fbg *fbg, int enable);
+
+    //! add an area to the dirty bounding box (dirty tracking must be enabled)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param x area X position (upper left coordinate)
+      \param y area Y position (upper left coordinate)
+      \param w area width
+      \param h area height
+      \sa fbg_setDirtyTracking()
+    */
+    extern void fbg_dirty(struct _fbg *fbg, int x, int y, int w, int h);
+
+    //! enable / disable a bitmap of the display tiles touched by the drawing functions (and fragments mixing) so that backends can present only what changed since the previous frame (see fbg_getPresentRects())
+    //! note : it enable dirty tracking (see fbg_setDirtyTracking()), the changed area of a frame is what it touched plus what the previous presented frame touched so the back buffer should be cleared with fbg_clear(fbg, 0) at the start of each frame (the whole display is presented otherwise)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param enable 1 to enable, 0 to disable (default)
+      \sa fbg_getPresentRects(), fbg_setDirtyTracking()
+    */
+    extern void fbg_setDirtyTiles(struct _fbg *fbg, int enable);
+
+    //! get the areas of the display changed by the frames presented since the previous call, for backends copying the display buffer to the device (draw / flip functions)
+    //! note : changed tiles are merged into rectangles : runs of tiles of a row are joined across small gaps, rows with identical runs are joined, the whole display is reported when most of it changed
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param rects receive a pointer to the areas (valid till the next call)
+      \return number of areas (0 = nothing changed), -1 when the whole display must be presented (dirty tiles disabled, first frame, resize or most of the display changed)
+      \sa fbg_setDirtyTiles()
+    */
+    extern int fbg_getPresentRects(struct _fbg *fbg, struct _fbg_bbox **rects);
+
+    //! enable detection of unchanged frames : fbg_flip() does not present them and fragments are put to sleep after a number of consecutive unchanged frames (static content)
+    //! note : with FBG_IDLE_EXPLICIT a frame is unchanged when fbg_unchanged() was called by the calling thread before fbg_draw() and by all fragments for the frame they drew, fbg_draw() then skip mixing, with FBG_IDLE_HASH fbg_flip() compare a hash of each FBG_TILE_SIZE tile of the back buffer with the presented frame
+    //! note : parked fragments draw nothing till fbg_wake() is called (input, new content etc.), fbg_draw() does not mix and fbg_flip() does not present meanwhile, with FBG_IDLE_HASH fbg_flip() still compare the back buffer with the first parked frame and wake the fragments when the calling thread drew something else (a clock etc.)
+    //! note : fbg_draw() does not call the backend draw function (fbdev copy / vertical sync wait) when the previous frame was not presented, fbg_flip() then sleep so that unchanged frames keep the rate of the presented ones (FBG_IDLE_FRAME_TIME till it is measured, fbg_setFramePacing() pace them otherwise)
+    //! note : fbg_flip() return immediately when a frame is not presented (no vertical sync wait), fbg_isIdle() / fbg_setFramePacing() can be used to slow down the drawing loop
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param mode FBG_IDLE_* flags (FBG_IDLE_NONE to disable, default)
+      \param park_frames number of consecutive unchanged frames after which fragments are parked, 0 = never
+      \sa fbg_unchanged(), fbg_wake(), fbg_isIdle()
+    */
+    extern void fbg_setIdleDetection(struct _fbg *fbg, int mode, int park_frames);
+
+    //! report that the frame being drawn is identical to the previous one (FBG_IDLE_EXPLICIT), called by fragments from their user_fragment function with their context or by the calling thread before fbg_draw()
+    //! note : fragments must still draw the frame, their buffers hold older frames
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \sa fbg_setIdleDetection()
+    */
+    extern void fbg_unchanged(struct _fbg *fbg);
+
+    //! resume fragments parked by idle detection, the next frames are mixed and presented again when they changed
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \sa fbg_setIdleDetection()
+    */
+    extern void fbg_wake(struct _fbg *fbg);
+
+    //! get the idle state of a context
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \return number of consecutive unchanged frames which were not presented (0 = the last frame was presented)
+      \sa fbg_setIdleDetection()
+    */
+    extern int fbg_isIdle(struct _fbg *fbg);
+
     //! set the filling color for fast drawing operations
     /*!
       \param fbg pointer to a FBG context / data structure
@@ -403,7 +1244,7 @@
       \param b
       \sa fbg_fpixel(), fbg_pixela()
     */
-    extern void fbg_pixel(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b);
+    _FBG_INLINE_API void fbg_pixel(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b);
 
     //! draw a pixel with alpha component (alpha blending)
     /*!
@@ -416,7 +1257,7 @@
       \param a
       \sa fbg_fpixel(), fbg_pixel()
     */
-    extern void fbg_pixela(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+    _FBG_INLINE_API void fbg_pixela(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b, unsigned char a);
 
     //! fast pixel drawing which use the fill color set by fbg_fill()
     /*!
@@ -425,7 +1266,7 @@
       \param y pixel Y position (upper left coordinate)
       \sa fbg_pixel(), fbg_fill(), fbg_pixela()
     */
-    extern void fbg_fpixel(struct _fbg *fbg, int x, int y);
+    _FBG_INLINE_API void fbg_fpixel(struct _fbg *fbg, int x, int y);
 
     //! direct pixel access from index value
     /*!
@@ -434,7 +1275,7 @@
       \param value color value
       \sa fbg_pixel(), fbg_fill(), fbg_pixela()
     */
-    extern void fbg_plot(struct _fbg *fbg, int index, unsigned char value);
+    _FBG_INLINE_API void fbg_plot(struct _fbg *fbg, int index, unsigned char value);
 
     //! draw a rectangle
     /*!
@@ -448,7 +1289,7 @@
       \param b
       \sa fbg_frect(), fbg_recta()
     */
-    extern void fbg_rect(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b);
+    _FBG_INLINE_API void fbg_rect(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b);
 
     //! draw a rectangle with alpha transparency
     /*!
@@ -463,7 +1304,7 @@
       \param a
       \sa fbg_frect(), fbg_rect()
     */
-    extern void fbg_recta(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+    _FBG_INLINE_API void fbg_recta(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a);
 
     //! fast rectangle drawing which use the fill color set by fbg_fill()
     /*!
@@ -487,7 +1328,7 @@
       \param b
       \sa fbg_vline, fbg_line()
     */
-    extern void fbg_hline(struct _fbg *fbg, int x, int y, int w, unsigned char r, unsigned char g, unsigned char b);
+    _FBG_INLINE_API void fbg_hline(struct _fbg *fbg, int x, int y, int w, unsigned char r, unsigned char g, unsigned char b);
 
     //! draw a vertical line
     /*!
@@ -500,7 +1341,7 @@
       \param b
       \sa fbg_hline, fbg_line()
     */
-    extern void fbg_vline(struct _fbg *fbg, int x, int y, int h, unsigned char r, unsigned char g, unsigned char b);
+    _FBG_INLINE_API void fbg_vline(struct _fbg *fbg, int x, int y, int h, unsigned char r, unsigned char g, unsigned char b);
 
     //! draw a line from two points (Bresenham algorithm)
     /*!
@@ -514,7 +1355,7 @@
       \param b
       \sa fbg_hline(), fbg_vline(), fbg_polygon()
     */
-    extern void fbg_line(struct _fbg *fbg, int x1, int y1, int x2, int y2, unsigned char r, unsigned char g, unsigned char b);
+    _FBG_INLINE_API void fbg_line(struct _fbg *fbg, int x1, int y1, int x2, int y2, unsigned char r, unsigned char g, unsigned char b);
 
     //! draw a polygon
     /*!
@@ -562,9 +1403,68 @@
     /*!
       \param fbg pointer to a FBG context / data structure
       \param sync_with_task 1 = wait for all fragment tasks to be finished before rendering
-      \param user_mixing a function used to mix the result of fragment tasks
+      \param user_mixing a function used to mix the result of fragment tasks, built-in mixing (see fbg_setMixing()) is used if NULL
+      \sa fbg_taskMixing(), fbg_setMixing()
     */
     extern void fbg_draw(struct _fbg *fbg, void (*user_mixing)(struct _fbg *fbg, unsigned char *buffer, int task_id));
+
+    //! set the built-in mixing mode of a task
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param task_id the task id (starting at 1)
+      \param mode one of FBG_MIXING_* mode
+      \param alpha alpha value [0,255] used by FBG_MIXING_ALPHA and FBG_MIXING_ALPHA_COLORKEY
+      \sa fbg_draw(), fbg_taskMixing(), fbg_setMixingColorkey()
+    */
+    extern void fbg_setMixing(struct _fbg *fbg, int task_id, enum _fbg_mixing_mode mode, int alpha);
+
+    //! split fbg_draw() mixing into horizontal stripes which are mixed in parallel by the calling thread and idle fragments threads
+    //! note : the mixing function is called for each stripe with a copy of the FBG context restricted to the stripe (back_buffer, height, width_n_height and size are adjusted) and the matching part of the task buffer, so it should only rely on these fields
+    //! note : with FBG_LFDS fragments threads are mostly busy rendering the next frame so the calling thread may do most of the work
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param stripes number of stripes (typically fragments count + 1), 0 to mix serially on the calling thread (default)
+      \sa fbg_draw()
+    */
+    extern void fbg_setMixingStripes(struct _fbg *fbg, int stripes);
+
+    //! set the colorkey of a task used by FBG_MIXING_COLORKEY and FBG_MIXING_ALPHA_COLORKEY built-in mixing mode
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param task_id the task id (starting at 1)
+      \param r
+      \param g
+      \param b
+      \sa fbg_setMixing()
+    */
+    extern void fbg_setMixingColorkey(struct _fbg *fbg, int task_id, unsigned char r, unsigned char g, unsigned char b);
+
+    //! built-in mixing function, mix a task buffer with the mode set by fbg_setMixing() (default to additive)
+    //! note : can be passed directly to fbg_draw(), it is used by default when fbg_draw() mixing function is NULL
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param buffer task buffer
+      \param task_id the task id
+      \sa fbg_draw(), fbg_setMixing()
+    */
+    extern void fbg_taskMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
+
+    //! saturated additive mixing function (built-in mixing, can be passed directly to fbg_draw())
+    extern void fbg_additiveMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
+    //! alpha blending mixing function with the task alpha value (built-in mixing, can be passed directly to fbg_draw())
+    extern void fbg_alphaMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
+    //! colorkeyed alpha blending mixing function with the task alpha value / colorkey (built-in mixing, can be passed directly to fbg_draw())
+    extern void fbg_alphaColorkeyMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
+    //! maximum mixing function (built-in mixing, can be passed directly to fbg_draw())
+    extern void fbg_maxMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
+    //! multiply mixing function (built-in mixing, can be passed directly to fbg_draw())
+    extern void fbg_multiplyMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
+    //! screen mixing function (built-in mixing, can be passed directly to fbg_draw())
+    extern void fbg_screenMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
+    //! colorkeyed copy mixing function with the task colorkey (built-in mixing, can be passed directly to fbg_draw())
+    extern void fbg_colorkeyMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
+    //! opaque copy mixing function (built-in mixing, can be passed directly to fbg_draw())
+    extern void fbg_copyMixing(struct _fbg *fbg, unsigned char *buffer, int task_id);
 #else
     //! draw to the screen
     /*!
@@ -829,6 +1729,162 @@
     extern float fbg_randf(float min, float max);
 
 #ifdef FBG_PARALLEL
+    //! set the number of buffers of each fragments, fragments can draw ahead of fbg_draw() by that many frames
+    //! note : with more than one buffer fragments draw into a buffer which hold the frame drawn queue_size frames ago (feedback effects), 1 = fragments wait till their buffer is mixed before drawing the next frame
+    //! note : the size is applied on the next fbg_createFragment() call, split rendering mode always use one buffer
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param queue_size number of buffers per fragment (default to 2, 7 with FBG_LFDS)
+      \sa fbg_createFragment()
+    */
+    extern void fbg_setFragmentQueueSize(struct _fbg *fbg, unsigned int queue_size);
+
+    //! limit the total size of the fragments buffers, they are borrowed from a buffer pool owned by the context which keep them for later use once fragments give them back (reconfiguration, fragments count changes etc.)
+    //! note : contexts sharing a thread pool also share the buffer pool (see fbg_sharePool()), the limit then cap the fragments buffers of all of them and any of them can set it
+    //! note : each fragment get an equal share of the limit so it may have less buffers than the queue size (see fbg_setFragmentQueueSize()) but never less than its minimum (1, 2 or 3 with FBG_DRAW_LATEST) which may exceed the limit
+    //! note : unused pooled buffers are freed when needed to stay within the limit, the limit is applied on the next fbg_createFragment() / fbg_reconfigureFragments() call
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param limit maximum size in bytes, 0 = unlimited (default)
+      \sa fbg_getBufferPoolStats(), fbg_trimBufferPool()
+    */
+    extern void fbg_setBufferPoolLimit(struct _fbg *fbg, size_t limit);
+
+    //! free the pooled buffers which are not used by fragments (buffers given back by terminated fragments, buffers of an older display size etc.)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \sa fbg_setBufferPoolLimit()
+    */
+    extern void fbg_trimBufferPool(struct _fbg *fbg);
+
+    //! get the buffer pool counters (allocated / borrowed size, number of buffers)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param stats pointer to a _fbg_buffer_pool_stats data structure which will be filled
+      \sa fbg_setBufferPoolLimit()
+    */
+    extern void fbg_getBufferPoolStats(struct _fbg *fbg, struct _fbg_buffer_pool_stats *stats);
+
+    //! set how long fragments threads and fbg_draw() spin when waiting on each other before going to sleep
+    //! note : spinning give the lowest latency but keep all cores busy even when the display is vsync-limited, sleeping (futex on Linux) save power / thermal headroom
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param spin_time spin time in microseconds (default to 100), 0 = sleep right away, -1 = never sleep (busy wait)
+      \sa fbg_getFragmentStats()
+    */
+    extern void fbg_setWaitSpin(struct _fbg *fbg, int spin_time);
+
+    //! get the area touched by a fragment in the frame being mixed, can be called from a mixing function to restrict it
+    //! note : the area is relative to the given context which may be a part of the main context (stripes etc.)
+    /*!
+      \param fbg pointer to the FBG context given to the mixing function
+      \param task_id the task id (starting at 1)
+      \param dirty pointer to a _fbg_bbox data structure which will be filled
+      \return 1 on success, 0 if the task does not exist
+      \sa fbg_setDirtyTracking()
+    */
+    extern int fbg_getFragmentDirty(struct _fbg *fbg, int task_id, struct _fbg_bbox *dirty);
+
+    //! set which fragments buffers fbg_draw() mix when fragments have more than one frame ready
+    //! note : with FBG_LFDS fragments overwrite their oldest frame when fbg_draw() is late so the default policy may mix frames of different sequence numbers, FBG_DRAW_MATCHING make sure all mixed frames come from the same pass
+    //! note : fbg_draw() still wait for a frame when a fragment has none ready except with FBG_DRAW_LATEST, dropped frames are given back to the fragments and counted (see fbg_getFragmentStats())
+    //! note : with FBG_DRAW_LATEST a slow fragment does not slow down the others nor fbg_draw(), its last frame is mixed till it complete a new one (fragments with no completed frame yet are not mixed), this policy should be set before fbg_createFragment() since fragments then stop waiting on each other and use at least 2 buffers (3 with FBG_LFDS), it has no effects in split rendering mode
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param policy one of FBG_DRAW_* policy (default to FBG_DRAW_QUEUE)
+      \sa fbg_getFragmentStats()
+    */
+    extern void fbg_setDrawPolicy(struct _fbg *fbg, enum _fbg_draw_policy policy);
+
+    //! get a fragment counters (frames count, time spent waiting on each side, dropped frames, last mixed frame)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param task_id the task id (starting at 1)
+      \param stats pointer to a _fbg_fragment_stats data structure which will be filled
+      \return 1 on success, 0 if the task does not exist
+      \sa fbg_setWaitSpin()
+    */
+    extern int fbg_getFragmentStats(struct _fbg *fbg, int task_id, struct _fbg_fragment_stats *stats);
+
+    //! let fbg_flip() adapt the number of fragments to meet a target frame time, times (fragments drawing, mixing, flip and time between flips) are averaged over a window of frames then a fragment is added or removed
+    //! note : a fragment is added when frames are over the target time and fragments drawing is the bottleneck, one is removed when mixing is the bottleneck (FBG_SPLIT_NONE) or when frames would still fit the target time with one less (which save memory / cores)
+    //! note : fragments are changed with fbg_reconfigureFragments() (the split areas follow the fragments count), fragments must draw a part of the same frame (split rendering mode) or interchangeable content for this to make sense
+    //! note : the window following a change is not taken into account, the target time should not be lower than the display refresh period (vsync)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param target_frame_time target frame time in microseconds, 0 = disabled (default)
+      \param min_tasks minimum number of fragments (at least 1)
+      \param max_tasks maximum number of fragments, 0 = number of CPUs
+      \param window number of frames times are averaged over (0 = 30)
+      \sa fbg_getAdaptiveStats(), fbg_reconfigureFragments()
+    */
+    extern void fbg_setAdaptiveFragments(struct _fbg *fbg, int target_frame_time, int min_tasks, int max_tasks, int window);
+
+    //! get the last adaptive fragments decision along with the average times it was based on
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param stats pointer to a _fbg_adaptive_stats data structure which will be filled
+      \return 1 when adaptive fragments are enabled, 0 otherwise
+      \sa fbg_setAdaptiveFragments()
+    */
+    extern int fbg_getAdaptiveStats(struct _fbg *fbg, struct _fbg_adaptive_stats *stats);
+
+    //! set how fragments created by fbg_createFragment() draw to the display
+    //! note : in split rendering mode each fragment own an area of the display back buffer and draw directly into it (fbg->width / fbg->height / fbg->line_length are the area ones and fbg->region give its position), no fragments buffers are allocated and fbg_draw() does not mix anything
+    //! note : fragments start drawing the next frame once fbg_flip() is called, the calling thread should only draw into the back buffer after fbg_draw() and before fbg_flip() (overlays etc.)
+    //! note : FBG_SPLIT_PASSTHROUGH avoid the extra buffer pass of a single fragment, it draw the whole frame into the back buffer so it must clear it itself (fbg_clear() by the calling thread after fbg_draw() would erase the fragment frame)
+    //! note : FBG_SPLIT_PASSTHROUGH is not used with several fragments (a warning is printed and they are mixed), they would only be safe if the back buffer was cleared by the calling thread between fbg_flip() and their next frame but fbg_flip() release them right away
+    //! note : the mode is applied on the next fbg_createFragment() call
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param mode one of FBG_SPLIT_* mode
+      \param columns number of tiles columns with FBG_SPLIT_TILES (0 = automatic), the tiles of the last row are stretched when the fragments count is not a multiple of it
+      \sa fbg_createFragment()
+    */
+    extern void fbg_setFragmentSplit(struct _fbg *fbg, enum _fbg_split_mode mode, int columns);
+
+    //! set the CPU a fragment thread run on (Linux only)
+    //! note : task id 0 set the default of fragments without settings of their own and of workers threads (see fbg_createWorkers()), it should be set first
+    //! note : settings are applied on the next fbg_createFragment() / fbg_reconfigureFragments() / fbg_createWorkers() call
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param task_id the task id (starting at 1), 0 = default
+      \param cpu CPU index, FBG_CPU_ANY (default) or FBG_CPU_AUTO (threads are spread over the CPUs)
+      \sa fbg_reserveCore(), fbg_setFragmentScheduling(), fbg_setFragmentStackSize()
+    */
+    extern void fbg_setFragmentAffinity(struct _fbg *fbg, int task_id, int cpu);
+
+    //! set the scheduling policy and priority of a fragment thread (real-time policies usually require privileges, a warning is printed when it fails)
+    //! note : see fbg_setFragmentAffinity() notes
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param task_id the task id (starting at 1), 0 = default
+      \param policy SCHED_OTHER (default), SCHED_FIFO or SCHED_RR
+      \param priority 0 with SCHED_OTHER, 1 to 99 with real-time policies
+      \sa fbg_setFragmentAffinity()
+    */
+    extern void fbg_setFragmentScheduling(struct _fbg *fbg, int task_id, int policy, int priority);
+
+    //! set the stack size of a fragment thread
+    //! note : see fbg_setFragmentAffinity() notes, threads reused by fbg_reconfigureFragments() keep their stack
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param task_id the task id (starting at 1), 0 = default
+      \param stack_size stack size in bytes (0 = system default)
+      \sa fbg_setFragmentAffinity()
+    */
+    extern void fbg_setFragmentStackSize(struct _fbg *fbg, int task_id, size_t stack_size);
+
+    //! pin the calling thread to a CPU which fragments and workers threads will then avoid (Linux only)
+    //! note : fragments / workers threads avoid it once created or reconfigured, -1 unpin the calling thread
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param cpu CPU index, -1 = none
+      \return 1 on success, 0 otherwise
+      \sa fbg_setFragmentAffinity()
+    */
+    extern int fbg_reserveCore(struct _fbg *fbg, int cpu);
+
     //! create a FB Graphics parallel task (also called a 'fragment')
     /*!
       \param fbg pointer to a FBG context / data structure
@@ -836,8 +1892,95 @@
       \param fragment a function taking a _fbg structure as argument and user_data pointer
       \param fragment_stop a function taking user_data pointer as argument
       \param parallel_tasks the number of parallel tasks to register
+      \sa fbg_reconfigureFragments()
     */
     extern void fbg_createFragment(struct _fbg *fbg, void *(*fragment_start)(struct _fbg *fbg), void (*fragment)(struct _fbg *fbg, void *user_data), void (*fragment_stop)(struct _fbg *fbg, void *user_data), unsigned int parallel_tasks);
+
+    //! change the fragments user functions and / or their number while reusing the fragments threads and buffers (faster than fbg_createFragment() which restart the fragments user data)
+    //! note : fragments are parked at the start of their loop meanwhile, the user data of a fragment is recreated (fragment_stop then fragment_start called by the fragment) only when the functions differ from the current ones
+    //! note : settings given to fragments on creation (queue size, split mode, draw policy etc.) are applied again, fragments buffers are cleared and fragments statistics are reset
+    //! note : act as fbg_createFragment() when there is no fragments
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param fragment_start a function taking a _fbg structure as argument
+      \param fragment a function taking a _fbg structure as argument and user_data pointer
+      \param fragment_stop a function taking user_data pointer as argument
+      \param parallel_tasks the number of parallel tasks, extra fragments are terminated and missing ones created
+      \sa fbg_createFragment()
+    */
+    extern void fbg_reconfigureFragments(struct _fbg *fbg, void *(*fragment_start)(struct _fbg *fbg), void (*fragment)(struct _fbg *fbg, void *user_data), void (*fragment_stop)(struct _fbg *fbg, void *user_data), unsigned int parallel_tasks);
+
+    //! create workers threads which only work on the context jobs (fbg_parallelFor(), parallel mixing)
+    //! note : fragments threads also work on jobs while they are idle (waiting for fbg_draw()) so the count should be the number of cores minus the fragments count to avoid oversubscription
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param count number of workers threads, existing workers are terminated first (0 = no workers, default)
+      \sa fbg_parallelFor()
+    */
+    extern void fbg_createWorkers(struct _fbg *fbg, unsigned int count);
+
+    //! make a FB Graphics context use the thread pool of another one so that their fragments and jobs share the same threads (several displays on a small device etc.)
+    //! note : fragments created afterwards by contexts sharing a pool have no thread of their own, each of their frames is a job (one work item per fragment) run by the pool workers threads and the threads waiting in fbg_draw(), the number of threads is then the number of workers whatever the number of contexts / fragments (see fbg_createWorkers())
+    //! note : threads look for work starting from a different job each time so that the frames of all contexts progress fairly, fbg_setFramePacing() let contexts which need less frames leave the pool threads to the others
+    //! note : it must be called before creating fragments / workers of the context, the pool is freed by the last fbg_close() call, workers should be created once by any context (their thread settings come from it)
+    //! note : workers should be created before the fragments, without workers the pooled fragments frames are run one after the other by the thread calling fbg_draw() (no parallelism, a warning is printed when the fragments are created)
+    //! note : the buffer pool of pool_fbg is shared as well so that fbg_setBufferPoolLimit() cap the fragments buffers of all the contexts together
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param pool_fbg pointer to the FBG context whose pool is shared
+      \sa fbg_createWorkers(), fbg_setFramePacing()
+    */
+    extern void fbg_sharePool(struct _fbg *fbg, struct _fbg *pool_fbg);
+
+    //! set the minimum time between two fbg_flip() calls, fbg_flip() sleep till that time is elapsed since the previous frame (frame rate cap, a frame late by more than that time restart the pacing)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param frame_time minimum frame time in microseconds, 0 = none (default)
+      \sa fbg_sharePool()
+    */
+    extern void fbg_setFramePacing(struct _fbg *fbg, int frame_time);
+
+    //! run a function over a range in parallel, the range is split into work items which are claimed by the calling thread, the workers threads and idle fragments threads
+    //! note : return when the whole range is processed, can be called from fragments (the main context pool is shared)
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param begin range start
+      \param end range end (excluded)
+      \param grain number of range values per work item (0 = automatic)
+      \param fn a function taking a _fbg structure, a part of the range (end excluded) and user_data pointer as arguments
+      \param user_data data given to fn
+      \sa fbg_parallelForAsync(), fbg_createWorkers()
+    */
+    extern void fbg_parallelFor(struct _fbg *fbg, int begin, int end, int grain, void (*fn)(struct _fbg *fbg, int begin, int end, void *user_data), void *user_data);
+
+    //! initialize a task group
+    /*!
+      \param group pointer to a _fbg_task_group data structure
+      \sa fbg_parallelForAsync(), fbg_waitTaskGroup()
+    */
+    extern void fbg_initTaskGroup(struct _fbg_task_group *group);
+
+    //! submit a parallel range job to a task group and return immediately (see fbg_parallelFor()), the range is processed by the workers threads, idle fragments threads and any thread waiting on a task group
+    //! note : the job is run on the calling thread when FBG_MAX_JOBS jobs are already pending
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param group pointer to an initialized _fbg_task_group data structure
+      \param begin range start
+      \param end range end (excluded)
+      \param grain number of range values per work item (0 = automatic)
+      \param fn a function taking a _fbg structure, a part of the range (end excluded) and user_data pointer as arguments
+      \param user_data data given to fn
+      \sa fbg_waitTaskGroup()
+    */
+    extern void fbg_parallelForAsync(struct _fbg *fbg, struct _fbg_task_group *group, int begin, int end, int grain, void (*fn)(struct _fbg *fbg, int begin, int end, void *user_data), void *user_data);
+
+    //! wait till all jobs of a task group are completed, the calling thread work on pending jobs meanwhile
+    /*!
+      \param fbg pointer to a FBG context / data structure
+      \param group pointer to a _fbg_task_group data structure
+      \sa fbg_parallelForAsync()
+    */
+    extern void fbg_waitTaskGroup(struct _fbg *fbg, struct _fbg_task_group *group);
 #endif
 
 // ### Helper functions
@@ -875,11 +2018,202 @@
     #define _FBG_MAX(a,b) ((a) > (b) ? a : b)
     //! integer MIN Math function
     #define _FBG_MIN(a,b) ((a) < (b) ? a : b)
+    //! integer multiplication of two [0,255] values normalized to [0,255] (a * b / 255 rounded)
+    #define _FBG_MUL255(a,b) ((((a) * (b) + 128) + (((a) * (b) + 128) >> 8)) >> 8)
     //! integer SIGN function
     #define _FBG_SGN(x) ((x<0)?-1:((x>0)?1:0))
+    //! swap the red and blue variables of a color when the render format is BGR ordered (see fbg_setFormat())
+    #define _FBG_NATIVE_RGB(fbg, r, b) do { if ((fbg)->bgr) { int _fbg_t = (r); (r) = (b); (b) = _fbg_t; } } while (0)
 
     //! convert a degree angle to radians
     #define _FBG_DEGTORAD(angle_degree) ((angle_degree) * M_PI / 180.0)
     //! convert a radian angle to degree
     #define _FBG_RADTODEG(angle_radians) ((angle_radians) * 180.0 / M_PI)
+
+// ### Hot primitives (static inline with FBG_INLINE, see _FBG_INLINE_API)
+
+#if defined(FBG_INLINE) || defined(FBG_PRIMITIVES_IMPLEMENTATION)
+    #include <string.h>
+    #include <stdlib.h>
+
+    //! add an area to the dirty bounding box, the call is skipped when dirty tracking is disabled
+    #define _FBG_DIRTY(fbg, x, y, w, h) do { if ((fbg)->dirty_tracking) { fbg_dirty(fbg, x, y, w, h); } } while (0)
+
+    // pack a color into a 4 components pixel, the padding component is 0 (see fbg_setFormat())
+    static inline uint32_t fbg_pixel32(unsigned char r, unsigned char g, unsigned char b) {
+        unsigned char c[4] = { r, g, b, 0 };
+        uint32_t v;
+
+        memcpy(&v, c, 4);
+
+        return v;
+    }
+
+    // fill a rectangle (colors in the render format), components is a constant at each call site so that the loops are specialized (32 bits stores for 4 components)
+    static inline void fbg_rectBody(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, const int components) {
+        if (w <= 0 || h <= 0) {
+            return;
+        }
+
+        unsigned char *org_pointer = fbg->back_buffer + y * fbg->line_length + x * components;
+        unsigned char *row_pointer = org_pointer;
+
+        int xx, yy;
+
+        if (components == 4) {
+            uint32_t *pix_pointer = (uint32_t *)org_pointer;
+            uint32_t v = fbg_pixel32(r, g, b);
+
+            for (xx = 0; xx < w; xx += 1) {
+                pix_pointer[xx] = v;
+            }
+        } else {
+            unsigned char *pix_pointer = org_pointer;
+
+            for (xx = 0; xx < w; xx += 1) {
+                pix_pointer[0] = r;
+                pix_pointer[1] = g;
+                pix_pointer[2] = b;
+                pix_pointer += 3;
+            }
+        }
+
+        for (yy = 1; yy < h; yy += 1) {
+            row_pointer += fbg->line_length;
+
+            memcpy(row_pointer, org_pointer, w * components);
+        }
+    }
+
+    // store a pixel (color in the render format), the dirty area is marked by the caller
+    static inline void fbg_pixelBody(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b) {
+        unsigned char *pix_pointer = fbg->back_buffer + y * fbg->line_length + x * fbg->components;
+
+        if (fbg->components == 4) {
+            *(uint32_t *)pix_pointer = fbg_pixel32(r, g, b);
+        } else {
+            pix_pointer[0] = r;
+            pix_pointer[1] = g;
+            pix_pointer[2] = b;
+        }
+    }
+
+    _FBG_INLINE_API void fbg_pixel(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b) {
+        _FBG_DIRTY(fbg, x, y, 1, 1);
+
+        _FBG_NATIVE_RGB(fbg, r, b);
+
+        fbg_pixelBody(fbg, x, y, r, g, b);
+    }
+
+    _FBG_INLINE_API void fbg_pixela(struct _fbg *fbg, int x, int y, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+        _FBG_DIRTY(fbg, x, y, 1, 1);
+
+        _FBG_NATIVE_RGB(fbg, r, b);
+
+        unsigned char *pix_pointer = fbg->back_buffer + y * fbg->line_length + x * fbg->components;
+
+        pix_pointer[0] = (a * r + (255 - a) * pix_pointer[0]) >> 8;
+        pix_pointer[1] = (a * g + (255 - a) * pix_pointer[1]) >> 8;
+        pix_pointer[2] = (a * b + (255 - a) * pix_pointer[2]) >> 8;
+
+        if (fbg->components == 4) {
+            pix_pointer[3] = 0;
+        }
+    }
+
+    _FBG_INLINE_API void fbg_fpixel(struct _fbg *fbg, int x, int y) {
+        _FBG_DIRTY(fbg, x, y, 1, 1);
+
+        memcpy(fbg->back_buffer + y * fbg->line_length + x * fbg->components, &fbg->fill_color, fbg->components);
+    }
+
+    _FBG_INLINE_API void fbg_plot(struct _fbg *fbg, int index, unsigned char value) {
+        _FBG_DIRTY(fbg, (index % fbg->line_length) / fbg->components, index / fbg->line_length, 1, 1);
+
+        fbg->back_buffer[index] = value;
+    }
+
+    _FBG_INLINE_API void fbg_rect(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b) {
+        _FBG_DIRTY(fbg, x, y, w, h);
+
+        _FBG_NATIVE_RGB(fbg, r, b);
+
+#ifdef FBG_INLINE
+        // once inlined the branch is usually hoisted out of the drawing loop
+        if (fbg->components == 4) {
+            fbg_rectBody(fbg, x, y, w, h, r, g, b, 4);
+        } else {
+            fbg_rectBody(fbg, x, y, w, h, r, g, b, 3);
+        }
+#else
+        fbg->primitives.rect(fbg, x, y, w, h, r, g, b);
+#endif
+    }
+
+    _FBG_INLINE_API void fbg_recta(struct _fbg *fbg, int x, int y, int w, int h, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+        _FBG_DIRTY(fbg, x, y, w, h);
+
+        _FBG_NATIVE_RGB(fbg, r, b);
+
+        fbg->primitives.recta(fbg, x, y, w, h, r, g, b, a);
+    }
+
+    _FBG_INLINE_API void fbg_hline(struct _fbg *fbg, int x, int y, int w, unsigned char r, unsigned char g, unsigned char b) {
+        fbg_rect(fbg, x, y, w, 1, r, g, b);
+    }
+
+    _FBG_INLINE_API void fbg_vline(struct _fbg *fbg, int x, int y, int h, unsigned char r, unsigned char g, unsigned char b) {
+        fbg_rect(fbg, x, y, 1, h, r, g, b);
+    }
+
+    // source : http://www.brackeen.com/vga/shapes.html
+    _FBG_INLINE_API void fbg_line(struct _fbg *fbg, int x1, int y1, int x2, int y2, unsigned char r, unsigned char g, unsigned char b) {
+        int i, dx, dy, sdx, sdy, dxabs, dyabs, x, y, px, py;
+
+        dx = x2 - x1;
+        dy = y2 - y1;
+        dxabs = abs(dx);
+        dyabs = abs(dy);
+        sdx = _FBG_SGN(dx);
+        sdy = _FBG_SGN(dy);
+        x = dyabs >> 1;
+        y = dxabs >> 1;
+        px = x1;
+        py = y1;
+
+        // the whole line is marked once, pixels are then stored without marking them
+        _FBG_DIRTY(fbg, _FBG_MIN(x1, x2), _FBG_MIN(y1, y2), dxabs + 1, dyabs + 1);
+
+        _FBG_NATIVE_RGB(fbg, r, b);
+
+        fbg_pixelBody(fbg, px, py, r, g, b);
+
+        if (dxabs >= dyabs) {
+            for (i = 0; i < dxabs; i += 1) {
+                y += dyabs;
+                if (y >= dxabs)
+                {
+                    y -= dxabs;
+                    py += sdy;
+                }
+                px += sdx;
+
+                fbg_pixelBody(fbg, px, py, r, g, b);
+            }
+        } else {
+            for (i = 0; i < dyabs; i += 1) {
+                x += dxabs;
+                if (x >= dyabs)
+                {
+                    x -= dyabs;
+                    px += sdx;
+                }
+                py += sdy;
+
+                fbg_pixelBody(fbg, px, py, r, g, b);
+            }
+        }
+    }
+#endif
 #endif